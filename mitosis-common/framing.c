@@ -0,0 +1,121 @@
+#include <string.h>
+#include "framing.h"
+
+uint16_t framing_crc16(const uint8_t *data, uint32_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (length--)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+// Consistent overhead byte stuffing, every run of up to 254 non zero bytes is
+// preceded by its length plus one, standing in for the zero that follows it
+static uint32_t cobs_encode(uint8_t *out, const uint8_t *in, uint32_t length)
+{
+    uint32_t code_at = 0;
+    uint32_t o = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        if (in[i] == 0)
+        {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+            continue;
+        }
+
+        out[o++] = in[i];
+        if (++code == 0xFF)
+        {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+        }
+    }
+    out[code_at] = code;
+
+    return o;
+}
+
+uint32_t framing_encode(uint8_t *out, uint8_t type, uint8_t sequence, uint8_t status,
+                        const uint8_t *body, uint32_t length)
+{
+    uint8_t raw[FRAMED_MAX_RAW];
+    uint16_t crc;
+    uint32_t encoded;
+
+    if (length > FRAMED_MAX_BODY)
+    {
+        length = FRAMED_MAX_BODY;
+    }
+
+    raw[0] = FRAMED_HEADER(type);
+    raw[FRAMED_SEQUENCE] = sequence;
+    raw[FRAMED_STATUS] = status;
+    memcpy(&raw[FRAMED_BODY], body, length);
+    length += FRAMED_BODY;
+
+    crc = framing_crc16(raw, length);
+    raw[length++] = crc >> 8;
+    raw[length++] = crc;
+
+    encoded = cobs_encode(out, raw, length);
+    out[encoded++] = FRAMED_DELIMITER;
+
+    return encoded;
+}
+
+uint32_t framing_decode(uint8_t *raw, const uint8_t *in, uint32_t length)
+{
+    uint32_t o = 0;
+    uint32_t i = 0;
+
+    while (i < length)
+    {
+        uint8_t code = in[i++];
+
+        if (code == 0 || i + code - 1 > length || o + code - 1 > FRAMED_MAX_RAW)
+        {
+            return 0;
+        }
+
+        for (uint8_t n = 1; n < code; n++)
+        {
+            if (in[i] == 0)
+            {
+                return 0;
+            }
+            raw[o++] = in[i++];
+        }
+
+        // every short run stands for a zero, bar the one ending the frame
+        if (code < 0xFF && i < length)
+        {
+            if (o >= FRAMED_MAX_RAW)
+            {
+                return 0;
+            }
+            raw[o++] = 0;
+        }
+    }
+
+    if (o < FRAMED_BODY + FRAMED_CRC_LENGTH ||
+        (raw[0] >> 4) != FRAMED_VERSION ||
+        framing_crc16(raw, o - FRAMED_CRC_LENGTH) != (raw[o - 2] << 8 | raw[o - 1]))
+    {
+        return 0;
+    }
+
+    return o - FRAMED_CRC_LENGTH;
+}
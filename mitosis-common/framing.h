@@ -0,0 +1,64 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <stdint.h>
+
+// Framed frames from the receiver to QMK, checked and numbered so the host
+// can stream at full rate and tell a lost or corrupt frame from a keystroke.
+// Before encoding a frame is:
+//
+//   [0]     header, FRAMED_VERSION << 4 | frame type
+//   [1]     sequence number, one more than the frame before
+//   [2]     status bits, FRAMED_STATUS_*
+//   [3..]   body, for FRAMED_KEYS the 10 bytes of data_buffer, for
+//           FRAMED_HID_REPORT an 8 byte boot keyboard report, for
+//           FRAMED_KEYCODES the same report then a byte of active layers,
+//           for FRAMED_BOARD_KEYS a board number then its 10 bytes, for
+//           FRAMED_LINK_STATS the radio link of a pipe, for
+//           FRAMED_POWER_STATS a pipe then power_stats_pack() of its half
+//   [n..]   CRC-16/CCITT-FALSE of everything before it, high byte first
+//
+// which is then COBS encoded, so it has no zero bytes, and ends with a zero.
+
+#define FRAMED_VERSION          1
+
+// Frame types
+#define FRAMED_KEYS             0       ///< QMK matrix rows, as in legacy frames
+#define FRAMED_HID_REPORT       1       ///< resolved keys, for a USB bridge
+#define FRAMED_KEYCODES         2       ///< resolved keys and layers, for QMK
+#define FRAMED_BOARD_KEYS       3       ///< QMK matrix rows of a board on other pipes
+#define FRAMED_LINK_STATS       4       ///< radio link quality of a pipe, on request
+#define FRAMED_POWER_STATS      5       ///< where a half's time goes, on request
+
+#define FRAMED_HEADER(type)     (FRAMED_VERSION << 4 | (type))
+#define FRAMED_TYPE(header)     ((header) & 0x0F)
+
+// Status bits
+#define FRAMED_STATUS_LEFT      0x01    ///< left half heard from within its timeout
+#define FRAMED_STATUS_RIGHT     0x02    ///< right half heard from within its timeout
+#define FRAMED_STATUS_LEFT_LOST 0x04    ///< left half packets lost since the last frame
+#define FRAMED_STATUS_RIGHT_LOST 0x08   ///< right half packets lost since the last frame
+#define FRAMED_STATUS_RESYNC    0x10    ///< key changes dropped, rebuilt from the keystates
+
+// Frame layout
+#define FRAMED_SEQUENCE         1
+#define FRAMED_STATUS           2
+#define FRAMED_BODY             3
+#define FRAMED_MAX_BODY         40
+#define FRAMED_CRC_LENGTH       2
+#define FRAMED_MAX_RAW          (FRAMED_BODY + FRAMED_MAX_BODY + FRAMED_CRC_LENGTH)
+#define FRAMED_MAX_ENCODED      (FRAMED_MAX_RAW + 2)    ///< COBS overhead and delimiter
+#define FRAMED_DELIMITER        0x00
+
+uint16_t framing_crc16(const uint8_t *data, uint32_t length);
+
+// Build, checksum and encode a frame into out, returning its encoded length
+// including the delimiter
+uint32_t framing_encode(uint8_t *out, uint8_t type, uint8_t sequence, uint8_t status,
+                        const uint8_t *body, uint32_t length);
+
+// Decode a frame received up to, but not including, its delimiter. Returns
+// the raw length, header to body, or 0 if it is malformed or fails the CRC.
+uint32_t framing_decode(uint8_t *raw, const uint8_t *in, uint32_t length);
+
+#endif
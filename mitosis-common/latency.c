@@ -0,0 +1,40 @@
+#include "latency.h"
+
+void latency_record(latency_t *hist, uint32_t ticks)
+{
+    uint32_t bucket = ticks >> hist->shift;
+
+    if (bucket >= LATENCY_BUCKETS)
+    {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+
+    hist->count[bucket]++;
+    hist->samples++;
+
+    if (ticks > hist->max)
+    {
+        hist->max = ticks;
+    }
+}
+
+uint32_t latency_percentile(const latency_t *hist, uint32_t percent)
+{
+    uint32_t seen = 0;
+
+    if (hist->samples == 0)
+    {
+        return 0;
+    }
+
+    for (uint32_t bucket = 0; bucket < LATENCY_BUCKETS - 1; bucket++)
+    {
+        seen += hist->count[bucket];
+        if (seen * 100 >= hist->samples * percent)
+        {
+            return ((bucket + 1) << hist->shift) - 1;
+        }
+    }
+
+    return hist->max;
+}
@@ -0,0 +1,28 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+// Latency histograms, for tuning the timing constants against real typing.
+// Each bucket is 1 << shift ticks wide, anything beyond the last bucket is
+// counted in it. Kept in RAM, to be read out with a debugger.
+
+#define LATENCY_BUCKETS 32
+
+typedef struct
+{
+    uint32_t count[LATENCY_BUCKETS];
+    uint32_t samples;
+    uint32_t max;               ///< longest latency seen, in ticks
+    uint32_t dropped;           ///< keystrokes that never made it through
+    uint8_t  shift;             ///< log2 of the ticks per bucket
+} latency_t;
+
+#define LATENCY_INIT(ticks_shift) { .shift = (ticks_shift) }
+
+void latency_record(latency_t *hist, uint32_t ticks);
+
+// Upper bound of the latency, in ticks, that percent of the samples are within
+uint32_t latency_percentile(const latency_t *hist, uint32_t percent);
+
+#endif
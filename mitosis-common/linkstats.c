@@ -0,0 +1,51 @@
+#include "linkstats.h"
+
+static void count(uint16_t *counter)
+{
+    if (*counter != 0xFFFF)
+    {
+        (*counter)++;
+    }
+}
+
+void link_stats_success(link_stats_t *stats, uint32_t attempts, uint32_t switches)
+{
+    uint8_t bucket = 0;
+
+    // power of two buckets, from the attempts less one
+    for (attempts = (attempts > 0) ? attempts - 1 : 0; attempts; attempts >>= 1)
+    {
+        bucket++;
+    }
+
+    count(&stats->attempts[(bucket < LINK_ATTEMPT_BUCKETS) ? bucket : LINK_ATTEMPT_BUCKETS - 1]);
+    count(&stats->switches[(switches < LINK_SWITCH_BUCKETS) ? switches : LINK_SWITCH_BUCKETS - 1]);
+}
+
+void link_stats_failed(link_stats_t *stats)
+{
+    count(&stats->failed);
+}
+
+uint32_t link_stats_pack(uint8_t *out, const link_stats_t *stats)
+{
+    const uint16_t *counter = (const uint16_t *)stats;
+
+    for (uint8_t i = 0; i < LINK_STATS_LENGTH / 2; i++)
+    {
+        out[2 * i] = counter[i];
+        out[2 * i + 1] = counter[i] >> 8;
+    }
+
+    return LINK_STATS_LENGTH;
+}
+
+void link_stats_unpack(link_stats_t *stats, const uint8_t *in)
+{
+    uint16_t *counter = (uint16_t *)stats;
+
+    for (uint8_t i = 0; i < LINK_STATS_LENGTH / 2; i++)
+    {
+        counter[i] = in[2 * i] | in[2 * i + 1] << 8;
+    }
+}
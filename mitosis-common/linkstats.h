@@ -0,0 +1,32 @@
+#ifndef LINKSTATS_H
+#define LINKSTATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Radio link quality of a half, as Gazell reports it for every packet sent.
+// Counts are totals since the half started, stopping at 65535, so a lost
+// telemetry packet loses nothing. Sent to the receiver in PACKET_TELEMETRY
+// payloads, see mitosis_protocol.h.
+
+#define LINK_ATTEMPT_BUCKETS    8       ///< 1, 2, 3-4, 5-8, 9-16, 17-32, 33-64 and 65 or more attempts
+#define LINK_SWITCH_BUCKETS     4       ///< 0, 1, 2, and 3 or more channel switches
+#define LINK_STATS_LENGTH       (2 * (LINK_ATTEMPT_BUCKETS + LINK_SWITCH_BUCKETS + 1))
+
+typedef struct
+{
+    uint16_t attempts[LINK_ATTEMPT_BUCKETS];    ///< packets delivered, by the attempts it took
+    uint16_t switches[LINK_SWITCH_BUCKETS];     ///< packets delivered, by the channel switches it took
+    uint16_t failed;                            ///< packets given up on after every attempt
+} link_stats_t;
+
+void link_stats_success(link_stats_t *stats, uint32_t attempts, uint32_t switches);
+void link_stats_failed(link_stats_t *stats);
+
+// Copy the counts into a payload, little endian, returning the length
+uint32_t link_stats_pack(uint8_t *out, const link_stats_t *stats);
+
+// Read back counts packed by link_stats_pack
+void link_stats_unpack(link_stats_t *stats, const uint8_t *in);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef MITOSIS_MATRIX_H
+#define MITOSIS_MATRIX_H
+
+#include <stdint.h>
+
+// Bit permutations between GPIO pins, the payload bitmap, and QMK's matrix,
+// done with nibble lookup tables generated at compile time. Each table maps
+// every 4 bit slice of its input to the output bits it sets, so remapping a
+// word costs one load per nibble instead of a test and shift per key.
+
+// Payload bitmap as one word, S01 in bit 23 down to S23 in bit 1
+#define WIRE_BIT(key)           (1UL << (23 - (key)))
+#define WIRE_WORD(bitmap)       ((uint32_t)(bitmap)[0] << 16 | (uint32_t)(bitmap)[1] << 8 | (bitmap)[2])
+
+// Position of each key in QMK's matrix, 5 rows of up to 5 columns per half.
+// Rows 3 and 4 have four keys. The left half is mirrored.
+#define MATRIX_ROWS             5
+#define MATRIX_COLS             5
+#define KEY_ROW(key)            ((key) < 15 ? (key) / 5 : (key) < 19 ? 3 : 4)
+#define KEY_COL(key)            ((key) < 15 ? (key) % 5 : (key) < 19 ? (key) - 15 : (key) - 19)
+#define RIGHT_MATRIX_BIT(key)   (1UL << (KEY_ROW(key) * MATRIX_COLS + KEY_COL(key)))
+#define LEFT_MATRIX_BIT(key)    (1UL << (KEY_ROW(key) * MATRIX_COLS + (MATRIX_COLS - 1) - KEY_COL(key)))
+
+// Matrix bits for each bit of the payload bitmap, bit 0 is unused
+#define LEFT_WIRE_MAP(bit)      ((bit) == 0 ? 0 : LEFT_MATRIX_BIT(23 - (bit)))
+#define RIGHT_WIRE_MAP(bit)     ((bit) == 0 ? 0 : RIGHT_MATRIX_BIT(23 - (bit)))
+
+// Table generators, MAP(bit) gives the output bits for a single input bit
+#define NIBBLE_ENTRY(MAP, n, v) (((v) & 1 ? MAP(4 * (n) + 0) : 0) | \
+                                 ((v) & 2 ? MAP(4 * (n) + 1) : 0) | \
+                                 ((v) & 4 ? MAP(4 * (n) + 2) : 0) | \
+                                 ((v) & 8 ? MAP(4 * (n) + 3) : 0))
+
+#define NIBBLE_ROW(MAP, n)      { NIBBLE_ENTRY(MAP, n,  0), NIBBLE_ENTRY(MAP, n,  1), \
+                                  NIBBLE_ENTRY(MAP, n,  2), NIBBLE_ENTRY(MAP, n,  3), \
+                                  NIBBLE_ENTRY(MAP, n,  4), NIBBLE_ENTRY(MAP, n,  5), \
+                                  NIBBLE_ENTRY(MAP, n,  6), NIBBLE_ENTRY(MAP, n,  7), \
+                                  NIBBLE_ENTRY(MAP, n,  8), NIBBLE_ENTRY(MAP, n,  9), \
+                                  NIBBLE_ENTRY(MAP, n, 10), NIBBLE_ENTRY(MAP, n, 11), \
+                                  NIBBLE_ENTRY(MAP, n, 12), NIBBLE_ENTRY(MAP, n, 13), \
+                                  NIBBLE_ENTRY(MAP, n, 14), NIBBLE_ENTRY(MAP, n, 15) }
+
+#define NIBBLE_LUT_24(MAP)      { NIBBLE_ROW(MAP, 0), NIBBLE_ROW(MAP, 1), NIBBLE_ROW(MAP, 2), \
+                                  NIBBLE_ROW(MAP, 3), NIBBLE_ROW(MAP, 4), NIBBLE_ROW(MAP, 5) }
+
+#define NIBBLE_LUT_32(MAP)      { NIBBLE_ROW(MAP, 0), NIBBLE_ROW(MAP, 1), NIBBLE_ROW(MAP, 2), \
+                                  NIBBLE_ROW(MAP, 3), NIBBLE_ROW(MAP, 4), NIBBLE_ROW(MAP, 5), \
+                                  NIBBLE_ROW(MAP, 6), NIBBLE_ROW(MAP, 7) }
+
+// Remap the low 4 * nibbles bits of a word through a table
+static inline uint32_t lut_remap(const uint32_t lut[][16], uint32_t in, uint32_t nibbles)
+{
+    uint32_t out = 0;
+
+    for (uint32_t n = 0; n < nibbles; n++)
+    {
+        out |= lut[n][in & 0x0F];
+        in >>= 4;
+    }
+
+    return out;
+}
+
+#endif
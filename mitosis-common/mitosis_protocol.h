@@ -0,0 +1,150 @@
+#ifndef MITOSIS_PROTOCOL_H
+#define MITOSIS_PROTOCOL_H
+
+#include <stdint.h>
+#include "linkstats.h"
+#include "powerstats.h"
+
+// Payloads sent by the keyboard halves to the receiver over Gazell.
+//
+// The original payload is a bare 3 byte bitmap, and is still accepted by the
+// receiver, told apart by its length. Versioned payloads look like:
+//
+//   [0]     header, PROTOCOL_VERSION << 4 | packet type
+//   [1]     sequence number of the first event in the packet
+//   [2..4]  bitmap of every key once the events are applied
+//   [5..]   events, one byte each, EVENT_PRESS | key index
+//
+// Every event takes the next sequence number, so the receiver can tell when
+// a packet has been lost, and fall back on the bitmap.
+//
+// Once a half has lined its clock up with the receiver's, see below, its
+// events are stamped with when the first of them moved:
+//
+//   [0]     header, PROTOCOL_VERSION << 4 | PACKET_STAMPED
+//   [1]     sequence number of the first event in the packet
+//   [2..4]  bitmap of every key once the events are applied
+//   [5..7]  receiver timebase ticks when the keys moved, little endian
+//   [8..]   events, one byte each, EVENT_PRESS | key index
+//
+// While keys are held, the halves keep them alive with short unchanged
+// payloads, at a backing off interval:
+//
+//   [0]     header, PROTOCOL_VERSION << 4 | PACKET_UNCHANGED
+//   [1]     sequence number of the next event
+//   [2..3]  milliseconds until the next keepalive, little endian
+//
+// A half pairing with a receiver asks for its addresses and a pipe, on the
+// shared pairing addresses and PAIRING_PIPE, see pairing.h:
+//
+//   [0]     header, PROTOCOL_VERSION << 4 | PACKET_PAIR
+//   [1..4]  the half's device ID, little endian
+//   [5]     the half's side, 0 left or 1 right
+//
+// and the receiver answers in the ACK payload of a later packet on the pipe,
+// whichever half sent it, so the half checks the answer is its own:
+//
+//   [0]     header, PROTOCOL_VERSION << 4 | PACKET_PAIRED
+//   [1..4]  base address 0, little endian
+//   [5..8]  base address 1, little endian
+//   [9..12] device ID of the half it answers, little endian
+//   [13]    the pipe the half is given
+//
+// Every so often while active, a half reports the quality of its link:
+//
+//   [0]     header, PROTOCOL_VERSION << 4 | PACKET_TELEMETRY
+//   [1..]   link_stats_pack() of its counts, see linkstats.h
+//
+// along with where its time went:
+//
+//   [0]     header, PROTOCOL_VERSION << 4 | PACKET_POWER
+//   [1..]   power_stats_pack() of its counts, see powerstats.h
+//
+// Every other ACK payload from the receiver carries its settings for the
+// half, taking effect without any extra packets:
+//
+//   [0]     header, PROTOCOL_VERSION << 4 | PACKET_CONTROL
+//   [1]     CONTROL_ flags
+//   [2]     longest keepalive gap in maintenance ticks, 0 for the half's own
+//   [3]     debounce algorithm, or CONTROL_DEBOUNCE_OWN for the half's own
+//   [4]     debounce press window, in debounce ticks, 1 to CONTROL_DEBOUNCE_MAX
+//   [5]     debounce release window, in debounce ticks, 1 to CONTROL_DEBOUNCE_MAX
+//   [6..8]  receiver timebase ticks when the ACK was loaded, little endian
+//
+// The ACK is loaded as the half's previous packet arrives, so the time in it
+// goes with the moment the half saw that packet delivered, to within a
+// Gazell timeslot, and the half can translate its own clock from there.
+
+#define PROTOCOL_VERSION        1
+
+// Receiver timebase, its free running 24 bit RTC counter
+#define TIMEBASE_HZ             32768
+#define TIMEBASE_MASK           0xFFFFFF
+
+#define KEY_COUNT               23      ///< switches on each half, S01 to S23
+#define BITMAP_LENGTH           3
+#define LEGACY_PAYLOAD_LENGTH   BITMAP_LENGTH
+
+// Packet types
+#define PACKET_STATE            0       ///< bitmap only, keeping held keys alive
+#define PACKET_EVENTS           1       ///< bitmap, and the events leading to it
+#define PACKET_UNCHANGED        2       ///< keystates as last sent, and the keepalive interval
+#define PACKET_PAIR             3       ///< asking for the receiver's addresses and a pipe
+#define PACKET_PAIRED           4       ///< the receiver's addresses and the pipe, in an ACK payload
+#define PACKET_TELEMETRY        5       ///< radio link counts
+#define PACKET_CONTROL          6       ///< the receiver's settings, in an ACK payload
+#define PACKET_STAMPED          7       ///< as PACKET_EVENTS, with when the keys moved
+#define PACKET_POWER            8       ///< time spent in each power state, and wakes
+
+#define PACKET_HEADER(type)     (PROTOCOL_VERSION << 4 | (type))
+#define PACKET_VERSION(header)  ((header) >> 4)
+#define PACKET_TYPE(header)     ((header) & 0x0F)
+
+// Payload layout
+#define PAYLOAD_HEADER          0
+#define PAYLOAD_SEQUENCE        1
+#define PAYLOAD_BITMAP          2
+#define PAYLOAD_EVENTS          (PAYLOAD_BITMAP + BITMAP_LENGTH)
+#define PAYLOAD_STAMP           PAYLOAD_EVENTS
+#define PAYLOAD_STAMPED_EVENTS  (PAYLOAD_STAMP + 3)
+#define PAYLOAD_MAX_LENGTH      (PAYLOAD_STAMPED_EVENTS + KEY_COUNT)
+#define PAYLOAD_INTERVAL        2
+#define UNCHANGED_PAYLOAD_LENGTH (PAYLOAD_INTERVAL + 2)
+#define PAYLOAD_DEVICE_ID       1
+#define PAYLOAD_SIDE            5
+#define PAIR_PAYLOAD_LENGTH     (PAYLOAD_SIDE + 1)
+#define PAYLOAD_BASE_ADDRESS_0  1
+#define PAYLOAD_BASE_ADDRESS_1  5
+#define PAYLOAD_PAIRED_ID       9
+#define PAYLOAD_PAIRED_PIPE     13
+#define PAIRED_PAYLOAD_LENGTH   (PAYLOAD_PAIRED_PIPE + 1)
+#define PAYLOAD_LINK_STATS      1
+#define TELEMETRY_PAYLOAD_LENGTH (PAYLOAD_LINK_STATS + LINK_STATS_LENGTH)
+#define PAYLOAD_POWER_STATS     1
+#define POWER_PAYLOAD_LENGTH    (PAYLOAD_POWER_STATS + POWER_STATS_LENGTH)
+#define PAYLOAD_CONTROL_FLAGS   1
+#define PAYLOAD_KEEPALIVE       2
+#define PAYLOAD_DEBOUNCE_MODE   3
+#define PAYLOAD_DEBOUNCE_PRESS  4
+#define PAYLOAD_DEBOUNCE_RELEASE 5
+#define PAYLOAD_TIME            6
+#define CONTROL_PAYLOAD_LENGTH  (PAYLOAD_TIME + 3)
+
+// Control flags
+#define CONTROL_RESEND          0x01    ///< packets were lost, send the full keystates
+#define CONTROL_LED             0x02    ///< light the half's LED
+#define CONTROL_DEBOUNCE_OWN    0xFF    ///< keep the debounce settings the half was built with
+#define CONTROL_DEBOUNCE_MODES  3       ///< debounce algorithms a half knows, see debounce.h
+#define CONTROL_DEBOUNCE_MAX    14      ///< longest window a half takes, DEBOUNCE_MAX of debounce.h
+
+// Key events
+#define EVENT_PRESS             0x80
+#define EVENT(key, pressed)     (((pressed) ? EVENT_PRESS : 0) | (key))
+#define EVENT_KEY(event)        ((event) & 0x1F)
+#define EVENT_PRESSED(event)    ((event) & EVENT_PRESS)
+
+// Bitmap position of a key, S01 is the top bit of the first byte
+#define BITMAP_BYTE(key)        ((key) >> 3)
+#define BITMAP_BIT(key)         (0x80 >> ((key) & 7))
+
+#endif
@@ -0,0 +1,109 @@
+#include <stddef.h>
+#include "nrf.h"
+#include "pairing.h"
+
+// The last page of flash, from the linker script
+extern uint32_t __pairing_start[];
+
+// Integer hash, every input bit affecting every output bit
+static uint32_t mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352D;
+    x ^= x >> 15;
+    x *= 0x846CA68B;
+    x ^= x >> 16;
+    return x;
+}
+
+// Runs of the same bit, and the preamble's alternating bits, are easily
+// matched by noise
+static bool address_ok(uint32_t address)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint8_t byte = address >> (8 * i);
+
+        if (byte == 0x00 || byte == 0xFF || byte == 0x55 || byte == 0xAA)
+        {
+            return false;
+        }
+    }
+
+    return address != PAIRING_BASE_ADDRESS_0 && address != PAIRING_BASE_ADDRESS_1;
+}
+
+static uint32_t pairing_check(const pairing_t *pairing)
+{
+    const uint32_t *words = (const uint32_t *)pairing;
+    uint32_t check = 0;
+
+    for (uint32_t i = 0; i < offsetof(pairing_t, check) / sizeof(uint32_t); i++)
+    {
+        check ^= words[i];
+    }
+
+    return ~check;
+}
+
+void pairing_derive(pairing_t *pairing, uint32_t id_0, uint32_t id_1)
+{
+    uint32_t seed = mix(id_0 ^ mix(id_1));
+
+    do
+    {
+        seed = mix(seed + 1);
+    } while (!address_ok(seed));
+    pairing->base_address_0 = seed;
+
+    do
+    {
+        seed = mix(seed + 1);
+    } while (!address_ok(seed) || seed == pairing->base_address_0);
+    pairing->base_address_1 = seed;
+}
+
+bool pairing_load(pairing_t *pairing)
+{
+    const pairing_t *stored = (const pairing_t *)__pairing_start;
+
+    if (stored->magic != PAIRING_MAGIC || stored->check != pairing_check(stored))
+    {
+        return false;
+    }
+
+    *pairing = *stored;
+    return true;
+}
+
+// Wait for the NVMC to finish a write or erase
+static void nvmc_wait(void)
+{
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy)
+    {
+    }
+}
+
+void pairing_store(pairing_t *pairing)
+{
+    const uint32_t *words = (const uint32_t *)pairing;
+
+    pairing->magic = PAIRING_MAGIC;
+    pairing->check = pairing_check(pairing);
+
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een;
+    nvmc_wait();
+    NRF_NVMC->ERASEPAGE = (uint32_t)(uintptr_t)__pairing_start;
+    nvmc_wait();
+
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Wen;
+    nvmc_wait();
+    for (uint32_t i = 0; i < sizeof(*pairing) / sizeof(uint32_t); i++)
+    {
+        __pairing_start[i] = words[i];
+        nvmc_wait();
+    }
+
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren;
+    nvmc_wait();
+}
@@ -0,0 +1,40 @@
+#ifndef PAIRING_H
+#define PAIRING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Gazell base addresses of each receiver, derived from its device ID, so
+// that boards in the same room don't hear each other. The halves learn them
+// by pairing, on the original addresses that every board shares, and are
+// given a pipe of their own at the same time. Both sides keep their pairing
+// in the last page of flash, set aside by their linker scripts.
+
+#define PAIRING_BASE_ADDRESS_0  0x01020304  ///< shared by every board, now only for pairing
+#define PAIRING_BASE_ADDRESS_1  0x05060708
+#define PAIRING_MAGIC           0x50414952
+#define PAIRING_PIPE            0           ///< halves ask to pair on it, never given to one
+#define PAIRING_PIPES           8           ///< Gazell pipes
+
+typedef struct
+{
+    uint32_t magic;             ///< PAIRING_MAGIC once stored
+    uint32_t base_address_0;
+    uint32_t base_address_1;
+    uint32_t pipes;             ///< pipes paired, a bit each, on the receiver, or the half's own
+    uint32_t ids[PAIRING_PIPES]; ///< device ID of the half given each pipe, on the receiver
+    uint32_t check;             ///< inverse of the other words xored, against a torn write
+} pairing_t;
+
+// Derive a receiver's base addresses from its device ID, steering clear of
+// the pairing addresses, and of bytes too regular to make good addresses
+void pairing_derive(pairing_t *pairing, uint32_t id_0, uint32_t id_1);
+
+// Read the pairing from flash, false if none was ever stored
+bool pairing_load(pairing_t *pairing);
+
+// Write the pairing to flash. Erasing the page stalls the CPU for around
+// 20ms, so the radio must be disabled first.
+void pairing_store(pairing_t *pairing);
+
+#endif
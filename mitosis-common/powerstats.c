@@ -0,0 +1,71 @@
+#include <string.h>
+#include "powerstats.h"
+
+void power_stats_start(power_stats_t *stats, uint16_t hz, uint8_t state, uint32_t now)
+{
+    if (stats->magic != POWER_MAGIC || stats->state >= POWER_STATES)
+    {
+        memset(stats, 0, sizeof(*stats));
+        stats->magic = POWER_MAGIC;
+    }
+
+    stats->hz = hz;
+    stats->state = state;
+    stats->since = now;
+}
+
+void power_stats_enter(power_stats_t *stats, uint8_t state, uint32_t now)
+{
+    stats->residency[stats->state] += now - stats->since;
+    stats->since = now;
+
+    if (state == POWER_SAMPLING && stats->state != POWER_SAMPLING)
+    {
+        stats->wakes++;
+    }
+    stats->state = state;
+}
+
+void power_stats_off(power_stats_t *stats, uint32_t now)
+{
+    power_stats_enter(stats, POWER_IDLE, now);
+    stats->offs++;
+}
+
+void power_stats_sent(power_stats_t *stats, uint32_t attempts)
+{
+    stats->sent++;
+    stats->retries += (attempts > 0) ? attempts - 1 : 0;
+}
+
+uint32_t power_stats_pack(uint8_t *out, const power_stats_t *stats)
+{
+    const uint32_t *counter = (const uint32_t *)stats;
+
+    out[0] = stats->hz;
+    out[1] = stats->hz >> 8;
+    for (uint8_t i = 0; i < POWER_COUNTS; i++)
+    {
+        for (uint8_t byte = 0; byte < 4; byte++)
+        {
+            out[2 + 4 * i + byte] = counter[i] >> (8 * byte);
+        }
+    }
+
+    return POWER_STATS_LENGTH;
+}
+
+void power_stats_unpack(power_stats_t *stats, const uint8_t *in)
+{
+    uint32_t *counter = (uint32_t *)stats;
+
+    stats->hz = in[0] | in[1] << 8;
+    for (uint8_t i = 0; i < POWER_COUNTS; i++)
+    {
+        counter[i] = 0;
+        for (uint8_t byte = 0; byte < 4; byte++)
+        {
+            counter[i] |= (uint32_t)in[2 + 4 * i + byte] << (8 * byte);
+        }
+    }
+}
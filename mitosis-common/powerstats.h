@@ -0,0 +1,55 @@
+#ifndef POWERSTATS_H
+#define POWERSTATS_H
+
+#include <stdint.h>
+
+// Where a half's time goes, for tuning battery life. The half keeps the counts
+// in RAM the startup code leaves alone, so they carry on through resets, and
+// sends them to the receiver in PACKET_POWER payloads, see mitosis_protocol.h.
+// Counts wrap around rather than stopping.
+
+// Power states, by which ticks are running
+#define POWER_IDLE          0   ///< neither, waiting for a key edge
+#define POWER_HELD          1   ///< the maintenance tick, for held keys or pairing
+#define POWER_SAMPLING      2   ///< the debounce tick
+#define POWER_STATES        3
+
+#define POWER_MAGIC         0x504F5752  ///< "POWR", the counts survived
+#define POWER_COUNTS        (4 + POWER_STATES)
+#define POWER_STATS_LENGTH  (2 + 4 * POWER_COUNTS)
+
+typedef struct
+{
+    uint32_t wakes;                     ///< key edges starting the debounce tick
+    uint32_t sent;                      ///< packets delivered or given up on
+    uint32_t retries;                   ///< attempts beyond the first, of every packet
+    uint32_t offs;                      ///< long idles powered down to System OFF
+    uint32_t residency[POWER_STATES];   ///< clock ticks spent in each state, awake is all but idle
+    uint16_t hz;                        ///< clock ticks per second
+    uint8_t  state;                     ///< one of the POWER_ states
+    uint32_t since;                     ///< clock when the state was entered
+    uint32_t magic;
+} power_stats_t;
+
+// Set up after a reset, in state as of now, carrying on with the counts if
+// the RAM kept them
+void power_stats_start(power_stats_t *stats, uint16_t hz, uint8_t state, uint32_t now);
+
+// Count the time spent in the state being left, and a wake if sampling starts.
+// Entering the same state brings its residency up to now.
+void power_stats_enter(power_stats_t *stats, uint8_t state, uint32_t now);
+
+// Powering down to System OFF, counted as idle up to now. The clock stops
+// until the reset that wakes the half, so the time off isn't counted.
+void power_stats_off(power_stats_t *stats, uint32_t now);
+
+// A packet delivered or given up on, after some attempts
+void power_stats_sent(power_stats_t *stats, uint32_t attempts);
+
+// Copy the tick rate and counts into a payload, little endian, returning the length
+uint32_t power_stats_pack(uint8_t *out, const power_stats_t *stats);
+
+// Read back counts packed by power_stats_pack
+void power_stats_unpack(power_stats_t *stats, const uint8_t *in);
+
+#endif
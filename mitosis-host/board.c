@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "mitosis.h"
+#include "mitosis_matrix.h"
+
+// QMK's replies to commands, and the end of a legacy frame, see the receiver
+#define FRAME_END       0xE0
+#define FIRST_ACK       0xE1
+#define LAST_ACK        0xE3
+
+// The pairing page, for pairing_store() to fill before it is copied to a chip
+uint32_t __pairing_start[256];
+
+// Switch pin of each key, S01 to S23
+static const uint8_t pins[2][BOARD_KEYS] = {
+    { L_S01, L_S02, L_S03, L_S04, L_S05, L_S06, L_S07, L_S08, L_S09, L_S10, L_S11, L_S12,
+      L_S13, L_S14, L_S15, L_S16, L_S17, L_S18, L_S19, L_S20, L_S21, L_S22, L_S23 },
+    { R_S01, R_S02, R_S03, R_S04, R_S05, R_S06, R_S07, R_S08, R_S09, R_S10, R_S11, R_S12,
+      R_S13, R_S14, R_S15, R_S16, R_S17, R_S18, R_S19, R_S20, R_S21, R_S22, R_S23 },
+};
+
+// Where a key is in data_buffer
+static uint32_t key_byte(uint32_t side, uint32_t key)
+{
+    return 2 * KEY_ROW(key) + side;
+}
+
+static uint8_t key_bit(uint32_t side, uint32_t key)
+{
+    uint32_t matrix = side == BOARD_RIGHT ? RIGHT_MATRIX_BIT(key) : LEFT_MATRIX_BIT(key);
+
+    return matrix >> (KEY_ROW(key) * MATRIX_COLS);
+}
+
+static void store(sim_chip_t *chip, pairing_t pairing)
+{
+    memset(__pairing_start, 0xFF, sizeof(__pairing_start));
+    pairing_store(&pairing);
+    memcpy(sim_flash(chip), __pairing_start, sizeof(__pairing_start));
+}
+
+// A transition QMK sees, matched against the oldest one typed on the key,
+// which must have happened already
+static void seen(board_t *board, uint32_t side, uint32_t key, bool pressed, uint64_t time)
+{
+    board_expected_t *expected = &board->expected[side][key];
+    board_transition_t *next = &expected->transition[expected->head];
+
+    if (!expected->count || next->pressed != pressed || next->time > time)
+    {
+        board->phantoms++;
+        return;
+    }
+
+    if (board->latencies == board->latency_space)
+    {
+        board->latency_space = board->latency_space ? 2 * board->latency_space : 1024;
+        board->latency = realloc(board->latency, board->latency_space * sizeof(uint64_t));
+    }
+    board->latency[board->latencies++] = time - next->time;
+    expected->head = (expected->head + 1) % BOARD_EXPECTED;
+    expected->count--;
+}
+
+static void apply(board_t *board, const uint8_t *rows, uint64_t time)
+{
+    for (uint32_t side = 0; side < 2; side++)
+    {
+        for (uint32_t key = 0; key < BOARD_KEYS; key++)
+        {
+            uint32_t byte = key_byte(side, key);
+            uint8_t bit = key_bit(side, key);
+
+            if ((board->keys[byte] ^ rows[byte]) & bit)
+            {
+                seen(board, side, key, rows[byte] & bit, time);
+            }
+        }
+    }
+    memcpy(board->keys, rows, BOARD_ROWS);
+}
+
+// Every byte the receiver sends, at the end of its stop bit
+static void receive(void *ctx, uint8_t byte, uint64_t time)
+{
+    board_t *board = ctx;
+    uint8_t raw[FRAMED_MAX_RAW];
+    uint32_t length;
+
+    if (board->framed)
+    {
+        if (byte != FRAMED_DELIMITER)
+        {
+            if (board->in_length < sizeof(board->in))
+            {
+                board->in[board->in_length] = byte;
+            }
+            board->in_length++;
+            return;
+        }
+
+        length = board->in_length <= sizeof(board->in) ?
+                 framing_decode(raw, board->in, board->in_length) : 0;
+        board->in_length = 0;
+        if (!length)
+        {
+            board->bad_frames++;
+            return;
+        }
+
+        board->frames++;
+        board->status = raw[FRAMED_STATUS];
+        if (FRAMED_TYPE(raw[0]) == FRAMED_KEYS && length == FRAMED_BODY + BOARD_ROWS)
+        {
+            apply(board, &raw[FRAMED_BODY], time);
+        }
+        else if (board->on_frame)
+        {
+            board->on_frame(board->ctx, raw, length);
+        }
+        return;
+    }
+
+    // legacy frames are rows with nothing above bit 4, then the end byte
+    if (byte >= FIRST_ACK && byte <= LAST_ACK && !board->in_length)
+    {
+        board->acks++;
+    }
+    else if (byte == FRAME_END)
+    {
+        if (board->in_length == BOARD_ROWS)
+        {
+            board->frames++;
+            apply(board, board->in, time);
+        }
+        else
+        {
+            board->bad_frames++;
+        }
+        board->in_length = 0;
+    }
+    else if (board->in_length < BOARD_ROWS)
+    {
+        board->in[board->in_length++] = byte;
+    }
+    else
+    {
+        board->bad_frames++;
+        board->in_length = 0;
+    }
+}
+
+// The board's addresses into every chip's flash, as if they had paired, and
+// the halves had been given the first pipes
+static void store_pairing(board_t *board)
+{
+    pairing_t pairing = board->pairing;
+
+    for (uint32_t side = 0; side < 2; side++)
+    {
+        pairing.pipes = 1 << BOARD_PIPE(side);
+        store(board->half[side], pairing);
+        board->pairing.pipes |= 1 << BOARD_PIPE(side);
+        board->pairing.ids[BOARD_PIPE(side)] = board->id[side];
+    }
+    store(board->receiver, board->pairing);
+}
+
+void board_init(board_t *board, uint32_t receiver_id, bool paired)
+{
+    board_init_halves(board, receiver_id, paired, &keyboard_left_firmware,
+                      &keyboard_right_firmware);
+}
+
+void board_init_halves(board_t *board, uint32_t receiver_id, bool paired,
+                       const sim_firmware_t *left, const sim_firmware_t *right)
+{
+    memset(board, 0, sizeof(board_t));
+    board->receiver = sim_chip(&receiver_firmware, receiver_id);
+    board->id[BOARD_LEFT] = receiver_id + 1;
+    board->id[BOARD_RIGHT] = receiver_id + 2;
+    board->half[BOARD_LEFT] = sim_chip(left, board->id[BOARD_LEFT]);
+    board->half[BOARD_RIGHT] = sim_chip(right, board->id[BOARD_RIGHT]);
+    sim_uart_listen(board->receiver, receive, board);
+
+    if (paired)
+    {
+        pairing_derive(&board->pairing, receiver_id, ~receiver_id);
+        store_pairing(board);
+    }
+}
+
+void board_share(board_t *board)
+{
+    board->pairing.base_address_0 = PAIRING_BASE_ADDRESS_0;
+    board->pairing.base_address_1 = PAIRING_BASE_ADDRESS_1;
+    store_pairing(board);
+}
+
+static void power_on(void *ctx)
+{
+    sim_power_on(ctx);
+}
+
+// The halves have batteries of their own, so come up some time apart
+void board_power_on(board_t *board)
+{
+    sim_power_on(board->receiver);
+    sim_at(sim_now() + sim_random() % (100 * SIM_MS), power_on, board->half[BOARD_LEFT]);
+    sim_at(sim_now() + sim_random() % (100 * SIM_MS), power_on, board->half[BOARD_RIGHT]);
+}
+
+void board_stream(board_t *board, bool framed)
+{
+    uint8_t command = framed ? 'F' : 'S';
+
+    board->framed = framed;
+    board->poll_interval = 0;
+    board->in_length = 0;
+    sim_uart_send(board->receiver, &command, 1);
+}
+
+// Each scan asks for a legacy frame, which QMK waits for before the rest of
+// its loop, well within the scan at 1Mbaud
+static void poll(void *ctx)
+{
+    board_t *board = ctx;
+    uint8_t command = 's';
+
+    if (!board->poll_interval)
+    {
+        return;
+    }
+    sim_uart_send(board->receiver, &command, 1);
+    sim_at(sim_now() + board->poll_interval, poll, board);
+}
+
+void board_poll(board_t *board, uint64_t interval)
+{
+    bool polling = board->poll_interval != 0;
+
+    board->framed = false;
+    board->poll_interval = interval;
+    board->in_length = 0;
+    if (!polling)
+    {
+        poll(board);
+    }
+}
+
+void board_key(board_t *board, uint32_t side, uint32_t key, bool pressed, uint64_t time,
+               uint64_t bounce)
+{
+    board_expected_t *expected = &board->expected[side][key];
+    uint32_t pin = pins[side][key];
+    uint32_t chatters = bounce ? sim_random() % 4 : 0;
+
+    if (expected->count == BOARD_EXPECTED)
+    {
+        fprintf(stderr, "board: too many transitions of a key in flight\n");
+        abort();
+    }
+    expected->transition[(expected->head + expected->count++) % BOARD_EXPECTED] =
+        (board_transition_t){ .time = time, .pressed = pressed };
+
+    // the contacts touch, then come apart and touch again a few times, each
+    // in its own slot of the bounce
+    sim_switch(board->half[side], pin, pressed, time);
+    for (uint32_t i = 0; i < 2 * chatters; i++)
+    {
+        uint64_t slot = bounce / (2 * chatters);
+
+        sim_switch(board->half[side], pin, i % 2 ? pressed : !pressed,
+                   time + i * slot + 1 + sim_random() % slot);
+    }
+}
+
+void board_tap(board_t *board, uint32_t side, uint32_t key, uint64_t time, uint64_t hold,
+               uint64_t bounce)
+{
+    board_key(board, side, key, true, time, bounce);
+    board_key(board, side, key, false, time + hold, bounce);
+}
+
+bool board_held(const board_t *board, uint32_t side, uint32_t key)
+{
+    return board->keys[key_byte(side, key)] & key_bit(side, key);
+}
+
+uint32_t board_dropped(const board_t *board)
+{
+    uint32_t dropped = 0;
+
+    for (uint32_t side = 0; side < 2; side++)
+    {
+        for (uint32_t key = 0; key < BOARD_KEYS; key++)
+        {
+            dropped += board->expected[side][key].count;
+        }
+    }
+    return dropped;
+}
+
+static int compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+uint64_t board_latency(board_t *board, uint32_t percent)
+{
+    uint32_t index = (board->latencies * percent + 99) / 100;
+
+    if (!board->latencies)
+    {
+        return 0;
+    }
+    qsort(board->latency, board->latencies, sizeof(uint64_t), compare);
+    return board->latency[index ? index - 1 : 0];
+}
+
+void board_report(board_t *board, const char *name)
+{
+    printf("%-28s %6u seen  p50 %6.2fms  p99 %6.2fms  max %6.2fms  dropped %u  phantoms %u\n",
+           name, board->latencies, board_latency(board, 50) / 1e6,
+           board_latency(board, 99) / 1e6, board_latency(board, 100) / 1e6,
+           board_dropped(board), board->phantoms);
+}
@@ -0,0 +1,114 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sim.h"
+#include "framing.h"
+#include "pairing.h"
+
+// A whole board in the simulator, both halves and the receiver, with QMK on
+// the receiver's UART decoding its frames into the data_buffer it would scan.
+// Every switch transition typed is expected to show up in data_buffer, and
+// is timed from the switch moving to the last byte of the frame carrying it.
+
+#define BOARD_LEFT      0
+#define BOARD_RIGHT     1
+#define BOARD_KEYS      23
+#define BOARD_ROWS      10      ///< bytes of data_buffer
+#define BOARD_EXPECTED  64      ///< transitions of a key in flight at once
+#define BOARD_QMK_SCAN  SIM_MS  ///< QMK's matrix scans when polling, taken as one a millisecond
+#define BOARD_PIPE(side) (1 + (side)) ///< pipe of each half, as the receiver gives them to a first board
+
+SIM_FIRMWARE(keyboard_left);
+SIM_FIRMWARE(keyboard_right);
+SIM_FIRMWARE(keyboard_left_edge);     ///< built with SAMPLE_ON_EDGE
+SIM_FIRMWARE(keyboard_right_edge);
+SIM_FIRMWARE(receiver);
+
+typedef struct
+{
+    uint64_t time;
+    bool pressed;
+} board_transition_t;
+
+typedef struct
+{
+    board_transition_t transition[BOARD_EXPECTED];
+    uint32_t head, count;
+} board_expected_t;
+
+typedef struct
+{
+    sim_chip_t *half[2];
+    sim_chip_t *receiver;
+    pairing_t pairing;                  ///< the receiver's addresses, if pre-paired
+    uint32_t id[2];                     ///< device ID of each half
+
+    // QMK's side of the UART
+    bool framed;                        ///< streaming framed frames, not legacy ones
+    uint64_t poll_interval;             ///< polling with 's' this often, 0 if streaming
+    uint8_t keys[BOARD_ROWS];           ///< data_buffer as of the last frame
+    uint8_t in[FRAMED_MAX_ENCODED];     ///< bytes of the frame being received
+    uint32_t in_length;
+    uint8_t status;                     ///< of the last framed frame
+    uint32_t frames;
+    uint32_t bad_frames;                ///< failing their CRC, or too long
+    uint32_t acks;                      ///< single byte replies
+
+    // frames other than keystates, such as link and power stats
+    void (*on_frame)(void *ctx, const uint8_t *raw, uint32_t length);
+    void *ctx;
+
+    // transitions typed and not yet seen by QMK, and how they went
+    board_expected_t expected[2][BOARD_KEYS];
+    uint64_t *latency;                  ///< of every transition seen, in ns
+    uint32_t latencies, latency_space;
+    uint32_t phantoms;                  ///< data_buffer changes nothing typed explains
+} board_t;
+
+// Add a board's chips to the simulator, receiver_id being the receiver's FICR
+// device ID, and the halves' following it. Pre-paired boards have the
+// receiver's own addresses in every flash, others start as out of the box.
+void board_init(board_t *board, uint32_t receiver_id, bool paired);
+
+// As board_init, with the halves running other images
+void board_init_halves(board_t *board, uint32_t receiver_id, bool paired,
+                       const sim_firmware_t *left, const sim_firmware_t *right);
+
+// Pair the board to the addresses every board shared before pairing, as the
+// firmware had them built in, to compare a crowded room against
+void board_share(board_t *board);
+
+// Power on the receiver now, and each half within the next 100ms
+void board_power_on(board_t *board);
+
+// QMK asking for streaming now, framed or legacy
+void board_stream(board_t *board, bool framed);
+
+// QMK polling with 's' from now on, once every interval, as its matrix_scan()
+// does, typically BOARD_QMK_SCAN
+void board_poll(board_t *board, uint64_t interval);
+
+// A switch moving at a time, with its contacts chattering for up to bounce
+// ns after, expecting the transition in data_buffer
+void board_key(board_t *board, uint32_t side, uint32_t key, bool pressed, uint64_t time,
+               uint64_t bounce);
+
+// Press and release, held for a duration
+void board_tap(board_t *board, uint32_t side, uint32_t key, uint64_t time, uint64_t hold,
+               uint64_t bounce);
+
+// True if QMK sees the key held
+bool board_held(const board_t *board, uint32_t side, uint32_t key);
+
+// Transitions typed and never seen, once the simulation has run well past them
+uint32_t board_dropped(const board_t *board);
+
+// Latency that percent of the transitions seen are within, in ns
+uint64_t board_latency(board_t *board, uint32_t percent);
+
+// Print the latencies and losses under a name, as one line
+void board_report(board_t *board, const char *name);
+
+#endif
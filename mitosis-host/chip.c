@@ -0,0 +1,47 @@
+#include "sim.h"
+
+// Built into every firmware image with SIM_NAME set to the image's name,
+// describing it to the simulator. The descriptor is the only symbol the image
+// leaves global once linked, see the Makefile, with its RAM in sections of its
+// own for the simulator to swap between the chips running it.
+
+#define CONCAT_(a, b)   a##b
+#define CONCAT(a, b)    CONCAT_(a, b)
+#define STRING_(a)      #a
+#define STRING(a)       STRING_(a)
+
+// Bounds of one of the image's sections, from the linker
+#define REGION(region)                                                              \
+    extern uint8_t CONCAT(CONCAT(__start_, SIM_NAME), region)[] __attribute__((weak)); \
+    extern uint8_t CONCAT(CONCAT(__stop_, SIM_NAME), region)[] __attribute__((weak))
+#define REGION_INIT(region)                                 \
+    {                                                       \
+        .start = CONCAT(CONCAT(__start_, SIM_NAME), region),  \
+        .stop = CONCAT(CONCAT(__stop_, SIM_NAME), region),    \
+    }
+
+REGION(_data);
+REGION(_bss);
+REGION(_noinit);
+REGION(_flash);
+
+int main();
+void GPIOTE_IRQHandler(void) __attribute__((weak));
+
+// The page pairing_store() writes, erased
+uint32_t __pairing_start[256] __attribute__((section(STRING(CONCAT(SIM_NAME, _flash))))) = {
+    [0 ... 255] = 0xFFFFFFFF
+};
+
+const sim_firmware_t CONCAT(SIM_NAME, _firmware) = {
+    .name = STRING(SIM_NAME),
+    .main = main,
+    .gpiote_irq = GPIOTE_IRQHandler,
+    .tx_success = nrf_gzll_device_tx_success,
+    .tx_failed = nrf_gzll_device_tx_failed,
+    .rx_data_ready = nrf_gzll_host_rx_data_ready,
+    .data = REGION_INIT(_data),
+    .bss = REGION_INIT(_bss),
+    .noinit = REGION_INIT(_noinit),
+    .flash = REGION_INIT(_flash),
+};
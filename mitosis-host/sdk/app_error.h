@@ -0,0 +1,19 @@
+#ifndef APP_ERROR_H
+#define APP_ERROR_H
+
+#include <stdint.h>
+
+// An SDK error stops the whole simulation, as it would leave the chip reset
+void app_error_handler_bare(uint32_t error_code);
+
+#define APP_ERROR_CHECK(err_code)                   \
+    do                                              \
+    {                                               \
+        uint32_t local_err_code = (err_code);       \
+        if (local_err_code != 0)                    \
+        {                                           \
+            app_error_handler_bare(local_err_code); \
+        }                                           \
+    } while (0)
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef APP_UTIL_PLATFORM_H
+#define APP_UTIL_PLATFORM_H
+
+#include "nrf.h"
+
+#define APP_IRQ_PRIORITY_HIGH   1
+#define APP_IRQ_PRIORITY_LOW    3
+
+// Interrupts only run while a chip sleeps, so there is nothing to mask. The
+// braces match the SDK's, which open and close a block.
+#define CRITICAL_REGION_ENTER() {
+#define CRITICAL_REGION_EXIT()  }
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef NRF_H
+#define NRF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Host stand-ins for the nRF51 registers the firmware touches. Every
+// simulated chip has its own set, and sim_regs points at the one of the chip
+// running. Plain registers are plain memory. Those with side effects go
+// through the simulator, see sim.c.
+
+typedef struct
+{
+    volatile uint32_t OUT, OUTSET, OUTCLR, IN, DIR, DIRSET, DIRCLR;
+    volatile uint32_t PIN_CNF[32];
+} NRF_GPIO_Type;
+
+typedef struct
+{
+    volatile uint32_t EVENTS_PORT;
+    volatile uint32_t INTENSET, INTENCLR;
+} NRF_GPIOTE_Type;
+
+typedef struct
+{
+    volatile uint32_t RESETREAS, SYSTEMOFF, RAMON;
+} NRF_POWER_Type;
+
+typedef struct
+{
+    volatile uint32_t DEVICEID[2];
+} NRF_FICR_Type;
+
+typedef struct
+{
+    volatile uint32_t READY, CONFIG, ERASEPAGE;
+} NRF_NVMC_Type;
+
+typedef struct
+{
+    volatile uint32_t TASKS_START, TASKS_STOP, TASKS_CLEAR, TASKS_SHUTDOWN;
+    volatile uint32_t TASKS_CAPTURE[4];
+    volatile uint32_t MODE, BITMODE, PRESCALER;
+    volatile uint32_t CC[4];
+} NRF_TIMER_Type;
+
+typedef struct
+{
+    volatile uint32_t COUNTER;
+} NRF_RTC_Type;
+
+// The registers of one chip
+typedef struct
+{
+    NRF_GPIO_Type gpio;
+    NRF_GPIOTE_Type gpiote;
+    NRF_POWER_Type power;
+    NRF_FICR_Type ficr;
+    NRF_NVMC_Type nvmc;
+    NRF_TIMER_Type timer[3];
+} sim_regs_t;
+
+extern sim_regs_t *sim_regs;
+
+// GPIO with IN reading the switches now, and a TIMER with the tasks written
+// to it since it was last looked at carried out
+NRF_GPIO_Type *sim_gpio(void);
+NRF_TIMER_Type *sim_timer(uint32_t id);
+
+// Entering System OFF ends the chip's run there and then
+void sim_system_off(void) __attribute__((noreturn));
+
+#define NRF_GPIO                (sim_gpio())
+#define NRF_GPIOTE              (&sim_regs->gpiote)
+#define NRF_POWER               (&sim_regs->power)
+#define NRF_FICR                (&sim_regs->ficr)
+#define NRF_NVMC                (&sim_regs->nvmc)
+#define NRF_TIMER0              (sim_timer(0))
+#define NRF_TIMER1              (sim_timer(1))
+
+#define GPIOTE_INTENSET_PORT_Msk        (1UL << 31)
+
+#define GPIO_PIN_CNF_SENSE_Pos          16
+#define GPIO_PIN_CNF_SENSE_Msk          (3UL << GPIO_PIN_CNF_SENSE_Pos)
+#define GPIO_PIN_CNF_SENSE_Disabled     0
+#define GPIO_PIN_CNF_SENSE_High         2
+#define GPIO_PIN_CNF_SENSE_Low          3
+#define GPIO_PIN_CNF_DIR_Msk            1UL
+
+#define POWER_RESETREAS_OFF_Msk         (1UL << 16)
+#define POWER_SYSTEMOFF_SYSTEMOFF_Enter (sim_system_off(), 1UL)
+#define POWER_RAMON_OFFRAM0_Pos         16
+#define POWER_RAMON_OFFRAM1_Pos         17
+#define POWER_RAMON_OFFRAM0_RAM0On      1
+#define POWER_RAMON_OFFRAM1_RAM1On      1
+
+#define NVMC_CONFIG_WEN_Ren             0
+#define NVMC_CONFIG_WEN_Wen             1
+#define NVMC_CONFIG_WEN_Een             2
+#define NVMC_READY_READY_Busy           0
+#define NVMC_READY_READY_Ready          1
+
+#define TIMER_MODE_MODE_Timer           0
+#define TIMER_BITMODE_BITMODE_16Bit     0
+#define TIMER_BITMODE_BITMODE_08Bit     1
+#define TIMER_BITMODE_BITMODE_24Bit     2
+#define TIMER_BITMODE_BITMODE_32Bit     3
+
+typedef enum
+{
+    UART0_IRQn = 2,
+    GPIOTE_IRQn = 6,
+    RTC0_IRQn = 11,
+    RTC1_IRQn = 17,
+} IRQn_Type;
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+
+// Sleeping hands the host CPU to the next chip
+void __WFE(void);
+void __SEV(void);
+
+#define NRF_SUCCESS             0
+#define NRF_ERROR_INVALID_STATE 8
+#define NRF_ERROR_BUSY          17
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef NRF_DELAY_H
+#define NRF_DELAY_H
+
+#include <stdint.h>
+
+// Firmware runs in no simulated time, busy waits included
+static inline void nrf_delay_us(uint32_t us)
+{
+}
+
+static inline void nrf_delay_ms(uint32_t ms)
+{
+}
+
+#endif
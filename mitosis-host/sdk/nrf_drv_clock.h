@@ -0,0 +1,13 @@
+#ifndef NRF_DRV_CLOCK_H
+#define NRF_DRV_CLOCK_H
+
+#include "nrf.h"
+
+typedef void (*nrf_drv_clock_handler_t)(int event);
+
+// The 32kHz crystal starts counting the RTCs sim_t.lfxo_startup after its request
+uint32_t nrf_drv_clock_init(void);
+void nrf_drv_clock_lfclk_request(nrf_drv_clock_handler_t handler);
+bool nrf_drv_clock_lfclk_is_running(void);
+
+#endif
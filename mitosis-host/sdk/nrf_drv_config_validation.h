@@ -0,0 +1,4 @@
+#ifndef NRF_DRV_CONFIG_VALIDATION_H
+#define NRF_DRV_CONFIG_VALIDATION_H
+
+#endif
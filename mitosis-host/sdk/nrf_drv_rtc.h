@@ -0,0 +1,72 @@
+#ifndef NRF_DRV_RTC_H
+#define NRF_DRV_RTC_H
+
+#include "nrf.h"
+#include "nrf_drv_config.h"
+
+#define RTC_COUNTER_COUNTER_Msk         0xFFFFFFUL
+#define RTC_INPUT_FREQ                  32768
+#define RTC_FREQ_TO_PRESCALER(freq)     (uint16_t)((RTC_INPUT_FREQ / (freq)) - 1)
+
+// An RTC of the running chip. p_reg only tells the instances apart, and the
+// prescaler comes from nrf_drv_config.h, as the SDK's default configuration.
+typedef struct
+{
+    NRF_RTC_Type *p_reg;
+    IRQn_Type irq;
+    uint8_t instance_id;
+    uint16_t prescaler;
+} nrf_drv_rtc_t;
+
+extern NRF_RTC_Type sim_rtc_reg[2];
+
+#define NRF_DRV_RTC_INSTANCE(id)                                        \
+    {                                                                   \
+        .p_reg = &sim_rtc_reg[id],                                      \
+        .irq = RTC##id##_IRQn,                                          \
+        .instance_id = id,                                              \
+        .prescaler = RTC_FREQ_TO_PRESCALER(RTC##id##_CONFIG_FREQUENCY), \
+    }
+
+typedef enum
+{
+    NRF_DRV_RTC_INT_COMPARE0 = 0,
+    NRF_DRV_RTC_INT_COMPARE1 = 1,
+    NRF_DRV_RTC_INT_COMPARE2 = 2,
+    NRF_DRV_RTC_INT_COMPARE3 = 3,
+    NRF_DRV_RTC_INT_TICK = 4,
+    NRF_DRV_RTC_INT_OVERFLOW = 5,
+} nrf_drv_rtc_int_type_t;
+
+typedef enum
+{
+    NRF_RTC_EVENT_TICK = 0x100,
+    NRF_RTC_EVENT_OVERFLOW = 0x104,
+} nrf_rtc_event_t;
+
+typedef struct
+{
+    uint16_t prescaler;
+    uint8_t interrupt_priority;
+} nrf_drv_rtc_config_t;
+
+typedef void (*nrf_drv_rtc_handler_t)(nrf_drv_rtc_int_type_t int_type);
+
+uint32_t nrf_drv_rtc_init(nrf_drv_rtc_t const * const p_instance,
+                          nrf_drv_rtc_config_t const * p_config,
+                          nrf_drv_rtc_handler_t handler);
+void nrf_drv_rtc_enable(nrf_drv_rtc_t const * const p_instance);
+void nrf_drv_rtc_disable(nrf_drv_rtc_t const * const p_instance);
+void nrf_drv_rtc_tick_enable(nrf_drv_rtc_t const * const p_instance, bool enable_irq);
+void nrf_drv_rtc_tick_disable(nrf_drv_rtc_t const * const p_instance);
+void nrf_drv_rtc_overflow_enable(nrf_drv_rtc_t const * const p_instance, bool enable_irq);
+uint32_t nrf_drv_rtc_cc_set(nrf_drv_rtc_t const * const p_instance, uint32_t channel,
+                            uint32_t val, bool enable_irq);
+uint32_t nrf_drv_rtc_cc_disable(nrf_drv_rtc_t const * const p_instance, uint32_t channel);
+uint32_t nrf_drv_rtc_counter_get(nrf_drv_rtc_t const * const p_instance);
+void nrf_drv_rtc_counter_clear(nrf_drv_rtc_t const * const p_instance);
+
+// Interrupts run as soon as their event, so none is ever left pending
+bool nrf_rtc_event_pending(NRF_RTC_Type *p_reg, nrf_rtc_event_t event);
+
+#endif
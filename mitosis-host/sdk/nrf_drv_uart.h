@@ -0,0 +1,72 @@
+#ifndef NRF_DRV_UART_H
+#define NRF_DRV_UART_H
+
+#include "nrf.h"
+
+typedef enum
+{
+    NRF_UART_BAUDRATE_115200 = 0x01D7E000,
+    NRF_UART_BAUDRATE_1000000 = 0x10000000,
+} nrf_uart_baudrate_t;
+
+typedef enum
+{
+    NRF_UART_HWFC_DISABLED,
+    NRF_UART_HWFC_ENABLED,
+} nrf_uart_hwfc_t;
+
+typedef enum
+{
+    NRF_UART_PARITY_EXCLUDED,
+    NRF_UART_PARITY_INCLUDED,
+} nrf_uart_parity_t;
+
+typedef struct
+{
+    uint32_t pseltxd, pselrxd, pselcts, pselrts;
+    void *p_context;
+    nrf_uart_hwfc_t hwfc;
+    nrf_uart_parity_t parity;
+    nrf_uart_baudrate_t baudrate;
+    uint8_t interrupt_priority;
+} nrf_drv_uart_config_t;
+
+#define NRF_DRV_UART_DEFAULT_CONFIG                                 \
+    {                                                               \
+        .hwfc = NRF_UART_HWFC_DISABLED,                             \
+        .parity = NRF_UART_PARITY_EXCLUDED,                         \
+        .baudrate = NRF_UART_BAUDRATE_115200,                       \
+        .interrupt_priority = 3,                                    \
+    }
+
+typedef enum
+{
+    NRF_DRV_UART_EVT_TX_DONE,
+    NRF_DRV_UART_EVT_RX_DONE,
+    NRF_DRV_UART_EVT_ERROR,
+} nrf_drv_uart_evt_type_t;
+
+typedef struct
+{
+    uint8_t *p_data;
+    uint8_t bytes;
+} nrf_drv_uart_xfer_evt_t;
+
+typedef struct
+{
+    nrf_drv_uart_evt_type_t type;
+    union
+    {
+        nrf_drv_uart_xfer_evt_t rxtx;
+    } data;
+} nrf_drv_uart_event_t;
+
+typedef void (*nrf_uart_event_handler_t)(nrf_drv_uart_event_t *p_event, void *p_context);
+
+// Bytes take 10 bit times at the configured rate each way, see sim_uart_*
+uint32_t nrf_drv_uart_init(nrf_drv_uart_config_t const *p_config,
+                           nrf_uart_event_handler_t event_handler);
+uint32_t nrf_drv_uart_tx(uint8_t const * const p_data, uint8_t length);
+uint32_t nrf_drv_uart_rx(uint8_t *p_data, uint8_t length);
+
+#endif
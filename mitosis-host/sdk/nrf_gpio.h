@@ -0,0 +1,29 @@
+#ifndef NRF_GPIO_H
+#define NRF_GPIO_H
+
+#include "nrf.h"
+
+typedef enum
+{
+    NRF_GPIO_PIN_NOPULL = 0,
+    NRF_GPIO_PIN_PULLDOWN = 1,
+    NRF_GPIO_PIN_PULLUP = 3,
+} nrf_gpio_pin_pull_t;
+
+typedef enum
+{
+    NRF_GPIO_PIN_NOSENSE = GPIO_PIN_CNF_SENSE_Disabled,
+    NRF_GPIO_PIN_SENSE_LOW = GPIO_PIN_CNF_SENSE_Low,
+    NRF_GPIO_PIN_SENSE_HIGH = GPIO_PIN_CNF_SENSE_High,
+} nrf_gpio_pin_sense_t;
+
+// Pin configuration goes through the simulator, as moving a sense can raise
+// the PORT event
+void nrf_gpio_cfg_output(uint32_t pin);
+void nrf_gpio_cfg_sense_input(uint32_t pin, nrf_gpio_pin_pull_t pull, nrf_gpio_pin_sense_t sense);
+void nrf_gpio_cfg_sense_set(uint32_t pin, nrf_gpio_pin_sense_t sense);
+void nrf_gpio_pin_write(uint32_t pin, uint32_t value);
+void nrf_gpio_pin_set(uint32_t pin);
+void nrf_gpio_pin_clear(uint32_t pin);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef NRF_GZLL_H
+#define NRF_GZLL_H
+
+#include "nrf.h"
+
+// Gazell, over the simulator's radio, see sim.c for what is modelled
+
+#define NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH   32
+#define NRF_GZLL_CONST_PIPE_COUNT           8
+#define NRF_GZLL_CONST_FIFO_LENGTH          3
+
+typedef enum
+{
+    NRF_GZLL_MODE_DEVICE,
+    NRF_GZLL_MODE_HOST,
+    NRF_GZLL_MODE_SUSPEND,
+} nrf_gzll_mode_t;
+
+typedef enum
+{
+    NRF_GZLL_ERROR_CODE_NO_ERROR = 0,
+    NRF_GZLL_ERROR_CODE_ATTEMPTED_TO_ADD_TO_FULL_FIFO = 8,
+} nrf_gzll_error_code_t;
+
+typedef struct
+{
+    uint32_t num_tx_attempts;
+    uint32_t num_channel_switches;
+    int8_t rssi;
+    bool payload_received_in_ack;
+} nrf_gzll_device_tx_info_t;
+
+typedef struct
+{
+    bool packet_received;
+    int8_t rssi;
+} nrf_gzll_host_rx_info_t;
+
+bool nrf_gzll_init(nrf_gzll_mode_t mode);
+bool nrf_gzll_enable(void);
+void nrf_gzll_disable(void);
+bool nrf_gzll_is_enabled(void);
+bool nrf_gzll_set_max_tx_attempts(uint16_t max_tx_attempts);
+bool nrf_gzll_set_base_address_0(uint32_t base_address);
+bool nrf_gzll_set_base_address_1(uint32_t base_address);
+bool nrf_gzll_add_packet_to_tx_fifo(uint32_t pipe, uint8_t *payload, uint32_t length);
+bool nrf_gzll_fetch_packet_from_rx_fifo(uint32_t pipe, uint8_t *payload, uint32_t *length);
+int32_t nrf_gzll_get_tx_fifo_packet_count(uint32_t pipe);
+int32_t nrf_gzll_get_rx_fifo_packet_count(uint32_t pipe);
+bool nrf_gzll_flush_tx_fifo(uint32_t pipe);
+bool nrf_gzll_flush_rx_fifo(uint32_t pipe);
+nrf_gzll_error_code_t nrf_gzll_get_error_code(void);
+
+// Callbacks, each firmware's own
+void nrf_gzll_device_tx_success(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info);
+void nrf_gzll_device_tx_failed(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info);
+void nrf_gzll_host_rx_data_ready(uint32_t pipe, nrf_gzll_host_rx_info_t rx_info);
+void nrf_gzll_disabled(void);
+
+#endif
@@ -0,0 +1,1836 @@
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "sim.h"
+#include "nrf_gpio.h"
+#include "nrf_drv_rtc.h"
+#include "nrf_drv_uart.h"
+#include "nrf_drv_clock.h"
+#include "app_error.h"
+
+#define CHIP_MAX                8
+#define IMAGE_MAX               16
+#define STACK_SIZE              (256 * 1024)
+#define LFCLK_HZ                32768ULL
+#define HFCLK_HZ                16000000ULL
+
+// Gazell, at its default timing. Packets are 9 bytes of preamble, address,
+// control and CRC around the payload, at 2Mbps.
+#define TIMESLOT                (600 * SIM_US)
+#define TURNAROUND              (130 * SIM_US)
+#define AIR_TIME(length)        ((9 + (length)) * 4 * SIM_US)
+#define ACK_WAIT                (TURNAROUND + AIR_TIME(NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH))
+#define CHANNELS                5
+#define TIMESLOTS_PER_CHANNEL   2
+#define AIR_RECORDS             64
+#define PIPES                   NRF_GZLL_CONST_PIPE_COUNT
+
+sim_config_t sim_config = {
+    .seed = 1,
+    .loss = 0,
+    .rssi = -50,
+    .lfxo_startup = 300 * SIM_MS,
+    .boot = 0,
+    .ppm = 20,
+    .jitter = 20 * SIM_US,
+};
+
+sim_regs_t *sim_regs;
+NRF_RTC_Type sim_rtc_reg[2];
+nrf_gzll_error_code_t nrf_gzll_error_code;
+
+typedef struct
+{
+    uint8_t data[NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH];
+    uint8_t length;
+    uint8_t id;                 ///< packet ID, telling a retransmission from a new packet
+} packet_t;
+
+typedef struct
+{
+    packet_t packet[NRF_GZLL_CONST_FIFO_LENGTH];
+    uint32_t count;
+} fifo_t;
+
+// A transmission on air, packet or ACK
+typedef struct
+{
+    uint64_t start, end;
+    uint32_t channel;
+    uint32_t id;
+} air_t;
+
+// An ACK a host is sending back for the packet on air
+typedef struct
+{
+    air_t air;
+    packet_t payload;
+    bool has_payload;
+} ack_t;
+
+typedef struct
+{
+    bool initialised, enabled;
+    nrf_gzll_mode_t mode;
+    uint32_t base[2];
+    uint16_t max_attempts;
+    fifo_t tx[PIPES], rx[PIPES];
+
+    // device, the packet being sent
+    bool busy;
+    uint32_t pipe;
+    uint32_t attempts, switches;
+    uint32_t channel;
+    uint64_t free;              ///< when the last timeslot used is over
+    uint64_t attempt_start;
+    uint8_t next_id[PIPES];
+    uint32_t epoch;             ///< bumped by disabling, retiring the attempt on air
+    air_t air;
+    ack_t ack[CHIP_MAX];
+    uint32_t acks;
+
+    // host, the last packet of each pipe and the ACK payload that went with it
+    bool last_valid[PIPES];
+    packet_t last[PIPES];
+    bool last_ack_valid[PIPES];
+    packet_t last_ack[PIPES];
+} radio_t;
+
+typedef struct
+{
+    bool initialised, enabled;
+    bool tick_int, overflow_int, cc_int[4];
+    uint32_t cc[4];
+    uint16_t prescaler;
+    nrf_drv_rtc_handler_t handler;
+    uint64_t origin;            ///< LFCLK cycle the counter was at base on
+    uint32_t base;
+    uint64_t from[6];           ///< LFCLK cycle each interrupt source was last dealt with
+} rtc_t;
+
+typedef struct
+{
+    bool running;
+    uint64_t start;
+    uint64_t held;              ///< ticks counted before start
+} timer_state_t;
+
+typedef struct
+{
+    bool initialised;
+    nrf_uart_event_handler_t handler;
+    void *context;
+    uint64_t byte_time;
+    bool tx_busy;
+    const uint8_t *tx_data;
+    uint8_t tx[256];
+    uint32_t tx_length;
+    uint64_t tx_start;
+    uint8_t *rx_buffer;
+    uint64_t rx_free;           ///< when the line is free for the next byte in
+} uart_t;
+
+typedef struct
+{
+    const sim_firmware_t *firmware;
+    uint8_t *pristine;          ///< .data as built
+    sim_chip_t *loaded;         ///< chip whose RAM and flash are in the image
+} image_t;
+
+struct sim_chip
+{
+    image_t *image;
+    uint8_t *ram;               ///< data, bss, noinit and flash, while not loaded
+    sim_regs_t regs;
+    uint32_t device_id;
+
+    bool powered;
+    bool off;                   ///< in System OFF
+    bool retained;              ///< RAM kept through System OFF
+    bool booted;                ///< main is due to start
+    bool started;
+    bool sleeping;              ///< main is waiting in __WFE
+    bool in_isr;
+    bool event;                 ///< the Cortex-M event register
+    uint32_t epoch;             ///< bumped by resets, retiring the events of the last run
+    ucontext_t context;
+    uint8_t *stack;
+    jmp_buf isr_exit;
+    uint32_t nvic;
+
+    uint32_t switches;          ///< pins pulled low by a pressed switch
+    bool detect;
+
+    bool lf_requested;
+    uint64_t lf_start;
+    uint64_t lf_period;         ///< of this chip's 32kHz crystal, in ps
+    uint64_t timeslot;          ///< Gazell's, timed by this chip's 16MHz crystal
+    rtc_t rtc[2];
+    timer_state_t timer[3];
+    radio_t radio;
+    uart_t uart;
+    void (*listener)(void *ctx, uint8_t byte, uint64_t time);
+    void *listener_ctx;
+
+    sim_counts_t counts;
+};
+
+typedef enum
+{
+    EVENT_CALL,
+    EVENT_SWITCH,
+    EVENT_BOOT,
+    EVENT_WAKE,
+    EVENT_ATTEMPT,
+    EVENT_PACKET_END,
+    EVENT_ACK_END,
+    EVENT_HOST_RX,
+    EVENT_UART_TX,
+    EVENT_UART_RX,
+} event_type_t;
+
+typedef struct
+{
+    uint64_t time;
+    uint64_t order;             ///< events at the same time run in the order they were made
+    event_type_t type;
+    sim_chip_t *chip;
+    uint32_t epoch;
+    uint32_t radio_epoch;
+    uint32_t arg;
+    void (*fn)(void *ctx);
+    void *ctx;
+} event_t;
+
+static uint64_t now;
+static uint64_t random_state;
+static sim_chip_t *chips[CHIP_MAX];
+static uint32_t chip_count;
+static image_t images[IMAGE_MAX];
+static sim_chip_t *running;
+static sim_regs_t idle_regs;
+static ucontext_t scheduler;
+static event_t *events;
+static uint32_t event_count, event_space;
+static uint64_t event_order;
+static air_t air[AIR_RECORDS];
+static uint32_t air_next, air_id;
+
+static void fail(const char *format, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+static void fail(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    fprintf(stderr, "sim: %llu.%06llums: ", (unsigned long long)(now / SIM_MS),
+            (unsigned long long)(now % SIM_MS));
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    abort();
+}
+
+void app_error_handler_bare(uint32_t error_code)
+{
+    fail("%s: SDK error %u", running ? running->image->firmware->name : "host", error_code);
+}
+
+uint32_t sim_random(void)
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (random_state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+double sim_random_unit(void)
+{
+    return sim_random() / 4294967296.0;
+}
+
+uint64_t sim_now(void)
+{
+    return now;
+}
+
+/*****************************************************************************/
+/** Events */
+/*****************************************************************************/
+
+static bool event_before(const event_t *a, const event_t *b)
+{
+    return a->time < b->time || (a->time == b->time && a->order < b->order);
+}
+
+static event_t *event_add(uint64_t time, event_type_t type, sim_chip_t *chip)
+{
+    event_t event = { .time = time, .order = event_order++, .type = type, .chip = chip,
+                      .epoch = chip ? chip->epoch : 0 };
+    uint32_t i;
+
+    if (time < now)
+    {
+        fail("event in the past");
+    }
+    if (event_count == event_space)
+    {
+        event_space = event_space ? 2 * event_space : 256;
+        events = realloc(events, event_space * sizeof(event_t));
+    }
+
+    // sift up
+    for (i = event_count++; i && event_before(&event, &events[(i - 1) / 2]); i = (i - 1) / 2)
+    {
+        events[i] = events[(i - 1) / 2];
+    }
+    events[i] = event;
+    return &events[i];
+}
+
+static event_t event_pop(void)
+{
+    event_t top = events[0];
+    event_t last = events[--event_count];
+    uint32_t i = 0;
+
+    // sift down
+    while (2 * i + 1 < event_count)
+    {
+        uint32_t child = 2 * i + 1;
+
+        if (child + 1 < event_count && event_before(&events[child + 1], &events[child]))
+        {
+            child++;
+        }
+        if (!event_before(&events[child], &last))
+        {
+            break;
+        }
+        events[i] = events[child];
+        i = child;
+    }
+    events[i] = last;
+    return top;
+}
+
+void sim_at(uint64_t time, void (*fn)(void *ctx), void *ctx)
+{
+    event_t *event = event_add(time, EVENT_CALL, NULL);
+
+    event->fn = fn;
+    event->ctx = ctx;
+}
+
+/*****************************************************************************/
+/** Images, RAM and flash */
+/*****************************************************************************/
+
+static uint32_t region_size(const sim_region_t *region)
+{
+    return region->stop - region->start;
+}
+
+static uint32_t image_size(const sim_firmware_t *firmware)
+{
+    return region_size(&firmware->data) + region_size(&firmware->bss) +
+           region_size(&firmware->noinit) + region_size(&firmware->flash);
+}
+
+// Copy between a chip's own RAM and the image's, region by region
+static void image_copy(sim_chip_t *chip, bool in)
+{
+    const sim_firmware_t *firmware = chip->image->firmware;
+    const sim_region_t *regions[] = { &firmware->data, &firmware->bss,
+                                      &firmware->noinit, &firmware->flash };
+    uint8_t *ram = chip->ram;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        uint32_t size = region_size(regions[i]);
+
+        if (in)
+        {
+            memcpy(regions[i]->start, ram, size);
+        }
+        else
+        {
+            memcpy(ram, regions[i]->start, size);
+        }
+        ram += size;
+    }
+}
+
+static void image_load(sim_chip_t *chip)
+{
+    image_t *image = chip->image;
+
+    if (image->loaded == chip)
+    {
+        return;
+    }
+    if (image->loaded)
+    {
+        image_copy(image->loaded, false);
+    }
+    image_copy(chip, true);
+    image->loaded = chip;
+}
+
+static void image_unload(sim_chip_t *chip)
+{
+    if (chip->image->loaded == chip)
+    {
+        image_copy(chip, false);
+        chip->image->loaded = NULL;
+    }
+}
+
+static image_t *image_find(const sim_firmware_t *firmware)
+{
+    for (uint32_t i = 0; i < IMAGE_MAX; i++)
+    {
+        if (images[i].firmware == firmware)
+        {
+            return &images[i];
+        }
+        if (!images[i].firmware)
+        {
+            // first seen, before any chip has run it, so .data is as built
+            images[i].firmware = firmware;
+            images[i].pristine = malloc(region_size(&firmware->data));
+            memcpy(images[i].pristine, firmware->data.start, region_size(&firmware->data));
+            return &images[i];
+        }
+    }
+    fail("too many images");
+}
+
+uint32_t *sim_flash(sim_chip_t *chip)
+{
+    const sim_firmware_t *firmware = chip->image->firmware;
+
+    image_unload(chip);
+    return (uint32_t *)(chip->ram + region_size(&firmware->data) + region_size(&firmware->bss) +
+                        region_size(&firmware->noinit));
+}
+
+/*****************************************************************************/
+/** Chips */
+/*****************************************************************************/
+
+static void enter(sim_chip_t *chip)
+{
+    image_load(chip);
+    running = chip;
+    sim_regs = &chip->regs;
+}
+
+static void timer_sync(sim_chip_t *chip, uint32_t id);
+
+static void leave(sim_chip_t *chip)
+{
+    for (uint32_t id = 0; id < 3; id++)
+    {
+        timer_sync(chip, id);
+    }
+    running = NULL;
+    sim_regs = &idle_regs;
+}
+
+sim_chip_t *sim_chip(const sim_firmware_t *firmware, uint32_t device_id)
+{
+    sim_chip_t *chip = calloc(1, sizeof(sim_chip_t));
+
+    if (chip_count == CHIP_MAX)
+    {
+        fail("too many chips");
+    }
+    chip->image = image_find(firmware);
+    chip->ram = malloc(image_size(firmware));
+    chip->stack = malloc(STACK_SIZE);
+    chip->device_id = device_id;
+
+    // every crystal is off by its own amount, so the chips drift apart
+    chip->lf_period = 1e12 / (LFCLK_HZ * (1 + (2 * sim_random_unit() - 1) * sim_config.ppm / 1e6));
+    chip->timeslot = TIMESLOT * (1 + (2 * sim_random_unit() - 1) * sim_config.ppm / 1e6);
+    memset(sim_flash(chip), 0xFF, region_size(&firmware->flash));
+    chips[chip_count++] = chip;
+    return chip;
+}
+
+void sim_init(void)
+{
+    for (uint32_t i = 0; i < chip_count; i++)
+    {
+        image_unload(chips[i]);
+        free(chips[i]->ram);
+        free(chips[i]->stack);
+        free(chips[i]);
+    }
+    chip_count = 0;
+    event_count = 0;
+    event_order = 0;
+    now = 0;
+    air_next = 0;
+    memset(air, 0, sizeof(air));
+    random_state = sim_config.seed * 0x9E3779B97F4A7C15ULL + 1;
+    idle_regs.nvmc.READY = NVMC_READY_READY_Ready;
+    sim_regs = &idle_regs;
+    running = NULL;
+}
+
+// Stop everything the chip was doing, for a reset, power loss or System OFF
+static void chip_stop(sim_chip_t *chip)
+{
+    chip->epoch++;
+    chip->booted = false;
+    chip->started = false;
+    chip->sleeping = false;
+    chip->event = false;
+    chip->nvic = 0;
+    chip->lf_requested = false;
+    memset(chip->rtc, 0, sizeof(chip->rtc));
+    memset(chip->timer, 0, sizeof(chip->timer));
+    memset(&chip->radio, 0, sizeof(chip->radio));
+    memset(&chip->uart, 0, sizeof(chip->uart));
+}
+
+// Start the chip from reset, with its RAM as a reset leaves it
+static void chip_reset(sim_chip_t *chip, uint32_t reason)
+{
+    const sim_firmware_t *firmware = chip->image->firmware;
+    uint32_t data = region_size(&firmware->data);
+    uint32_t bss = region_size(&firmware->bss);
+    uint32_t noinit = region_size(&firmware->noinit);
+
+    chip_stop(chip);
+    image_unload(chip);
+    memcpy(chip->ram, chip->image->pristine, data);
+    memset(chip->ram + data, 0, bss);
+    if (!reason || !chip->retained)
+    {
+        for (uint32_t i = 0; i < noinit; i++)
+        {
+            chip->ram[data + bss + i] = sim_random();
+        }
+    }
+
+    // the reset reasons pile up until written back, and power on clears them
+    reason = reason ? chip->regs.power.RESETREAS | reason : 0;
+    memset(&chip->regs, 0, sizeof(chip->regs));
+    chip->regs.power.RESETREAS = reason;
+    chip->regs.ficr.DEVICEID[0] = chip->device_id;
+    chip->regs.ficr.DEVICEID[1] = ~chip->device_id * 0x9E3779B9;
+    chip->regs.nvmc.READY = NVMC_READY_READY_Ready;
+    chip->detect = false;
+    chip->off = false;
+    chip->counts.resets++;
+
+    event_add(now + sim_config.boot, EVENT_BOOT, chip);
+}
+
+void sim_power_on(sim_chip_t *chip)
+{
+    if (!chip->powered)
+    {
+        chip->powered = true;
+        chip_reset(chip, 0);
+    }
+}
+
+void sim_power_off(sim_chip_t *chip)
+{
+    chip->powered = false;
+    chip->off = false;
+    chip_stop(chip);
+}
+
+bool sim_system_is_off(const sim_chip_t *chip)
+{
+    return chip->off;
+}
+
+const sim_counts_t *sim_counts(const sim_chip_t *chip)
+{
+    return &chip->counts;
+}
+
+
+/*****************************************************************************/
+/** Running firmware */
+/*****************************************************************************/
+
+typedef enum
+{
+    ISR_RTC,
+    ISR_GPIOTE,
+    ISR_TX_SUCCESS,
+    ISR_TX_FAILED,
+    ISR_RX_DATA_READY,
+    ISR_UART,
+} isr_type_t;
+
+typedef struct
+{
+    isr_type_t type;
+    uint32_t index;             ///< RTC or pipe
+    uint32_t sources;           ///< RTC interrupt sources due
+    nrf_gzll_device_tx_info_t tx_info;
+    nrf_gzll_host_rx_info_t rx_info;
+    nrf_drv_uart_event_t uart;
+} isr_t;
+
+static void chip_main(void)
+{
+    sim_chip_t *chip = running;
+
+    chip->image->firmware->main();
+    fail("%s: main returned", chip->image->firmware->name);
+}
+
+// Run main until it sleeps, from the start or from the __WFE it slept in
+static void run_main(sim_chip_t *chip)
+{
+    enter(chip);
+    if (!chip->started)
+    {
+        chip->started = true;
+        getcontext(&chip->context);
+        chip->context.uc_stack.ss_sp = chip->stack;
+        chip->context.uc_stack.ss_size = STACK_SIZE;
+        chip->context.uc_link = NULL;
+        makecontext(&chip->context, chip_main, 0);
+    }
+    chip->sleeping = false;
+    swapcontext(&scheduler, &chip->context);
+    leave(chip);
+}
+
+void __WFE(void)
+{
+    sim_chip_t *chip = running;
+
+    if (chip->in_isr)
+    {
+        fail("%s: __WFE in an interrupt", chip->image->firmware->name);
+    }
+    if (!chip->event)
+    {
+        chip->sleeping = true;
+        swapcontext(&chip->context, &scheduler);
+    }
+    chip->event = false;
+}
+
+void __SEV(void)
+{
+    running->event = true;
+}
+
+static void isr_call(sim_chip_t *chip, const isr_t *isr)
+{
+    const sim_firmware_t *firmware = chip->image->firmware;
+
+    switch (isr->type)
+    {
+    case ISR_RTC:
+        for (uint32_t source = 0; source <= NRF_DRV_RTC_INT_OVERFLOW; source++)
+        {
+            rtc_t *rtc = &chip->rtc[isr->index];
+
+            if (!(isr->sources & (1 << source)))
+            {
+                continue;
+            }
+
+            // the SDK's handler disables a compare interrupt as it fires
+            if (source <= NRF_DRV_RTC_INT_COMPARE3 && rtc->cc_int[source])
+            {
+                rtc->cc_int[source] = false;
+                rtc->handler(source);
+            }
+            else if ((source == NRF_DRV_RTC_INT_TICK && rtc->tick_int) ||
+                     (source == NRF_DRV_RTC_INT_OVERFLOW && rtc->overflow_int))
+            {
+                rtc->handler(source);
+            }
+        }
+        break;
+    case ISR_GPIOTE:
+        firmware->gpiote_irq();
+        break;
+    case ISR_TX_SUCCESS:
+        firmware->tx_success(isr->index, isr->tx_info);
+        break;
+    case ISR_TX_FAILED:
+        firmware->tx_failed(isr->index, isr->tx_info);
+        break;
+    case ISR_RX_DATA_READY:
+        firmware->rx_data_ready(isr->index, isr->rx_info);
+        break;
+    case ISR_UART:
+        chip->uart.handler((nrf_drv_uart_event_t *)&isr->uart, chip->uart.context);
+        break;
+    }
+}
+
+// Run an interrupt to completion, on the scheduler's stack, and set the event
+// it leaves behind for __WFE
+static void isr_run(sim_chip_t *chip, const isr_t *isr)
+{
+    enter(chip);
+    chip->in_isr = true;
+    chip->counts.isrs++;
+    if (!setjmp(chip->isr_exit))
+    {
+        isr_call(chip, isr);
+    }
+    chip->in_isr = false;
+    if (!chip->off)
+    {
+        chip->event = true;
+    }
+    leave(chip);
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+    running->nvic |= 1UL << irq;
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq)
+{
+    running->nvic &= ~(1UL << irq);
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority)
+{
+}
+
+/*****************************************************************************/
+/** GPIO, and System OFF */
+/*****************************************************************************/
+
+static bool pin_level(const sim_chip_t *chip, uint32_t pin)
+{
+    uint32_t cnf = chip->regs.gpio.PIN_CNF[pin];
+
+    if (cnf & GPIO_PIN_CNF_DIR_Msk)
+    {
+        return chip->regs.gpio.OUT & (1UL << pin);
+    }
+
+    // switches pull their pins to ground, against the pull up
+    return !(chip->switches & (1UL << pin)) && ((cnf >> 2) & 3) != NRF_GPIO_PIN_PULLDOWN;
+}
+
+// The DETECT signal, any pin at the level its sense is set for
+static bool detect_now(const sim_chip_t *chip)
+{
+    for (uint32_t pin = 0; pin < 32; pin++)
+    {
+        uint32_t sense = (chip->regs.gpio.PIN_CNF[pin] & GPIO_PIN_CNF_SENSE_Msk) >>
+                         GPIO_PIN_CNF_SENSE_Pos;
+
+        if ((sense == GPIO_PIN_CNF_SENSE_Low && !pin_level(chip, pin)) ||
+            (sense == GPIO_PIN_CNF_SENSE_High && pin_level(chip, pin)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// A rising DETECT raises the PORT event, or wakes the chip from System OFF
+static void detect_update(sim_chip_t *chip)
+{
+    bool detect = detect_now(chip);
+
+    if (detect && !chip->detect)
+    {
+        if (chip->off)
+        {
+            event_add(now, EVENT_WAKE, chip);
+        }
+        else
+        {
+            chip->regs.gpiote.EVENTS_PORT = 1;
+        }
+    }
+    chip->detect = detect;
+}
+
+static bool gpiote_pending(const sim_chip_t *chip)
+{
+    return chip->regs.gpiote.EVENTS_PORT && (chip->regs.gpiote.INTENSET & GPIOTE_INTENSET_PORT_Msk) &&
+           (chip->nvic & (1UL << GPIOTE_IRQn));
+}
+
+NRF_GPIO_Type *sim_gpio(void)
+{
+    uint32_t in = 0;
+
+    for (uint32_t pin = 0; pin < 32; pin++)
+    {
+        in |= (uint32_t)pin_level(running, pin) << pin;
+    }
+    running->regs.gpio.IN = in;
+    return &running->regs.gpio;
+}
+
+void nrf_gpio_cfg_output(uint32_t pin)
+{
+    running->regs.gpio.PIN_CNF[pin] = GPIO_PIN_CNF_DIR_Msk;
+    running->regs.gpio.DIR |= 1UL << pin;
+    detect_update(running);
+}
+
+void nrf_gpio_cfg_sense_input(uint32_t pin, nrf_gpio_pin_pull_t pull, nrf_gpio_pin_sense_t sense)
+{
+    running->regs.gpio.PIN_CNF[pin] = (pull << 2) | ((uint32_t)sense << GPIO_PIN_CNF_SENSE_Pos);
+    running->regs.gpio.DIR &= ~(1UL << pin);
+    detect_update(running);
+}
+
+void nrf_gpio_cfg_sense_set(uint32_t pin, nrf_gpio_pin_sense_t sense)
+{
+    running->regs.gpio.PIN_CNF[pin] = (running->regs.gpio.PIN_CNF[pin] & ~GPIO_PIN_CNF_SENSE_Msk) |
+                                      ((uint32_t)sense << GPIO_PIN_CNF_SENSE_Pos);
+    detect_update(running);
+}
+
+void nrf_gpio_pin_write(uint32_t pin, uint32_t value)
+{
+    if (value)
+    {
+        nrf_gpio_pin_set(pin);
+    }
+    else
+    {
+        nrf_gpio_pin_clear(pin);
+    }
+}
+
+void nrf_gpio_pin_set(uint32_t pin)
+{
+    running->regs.gpio.OUT |= 1UL << pin;
+}
+
+void nrf_gpio_pin_clear(uint32_t pin)
+{
+    running->regs.gpio.OUT &= ~(1UL << pin);
+}
+
+bool sim_pin_out(const sim_chip_t *chip, uint32_t pin)
+{
+    return chip->regs.gpio.OUT & (1UL << pin);
+}
+
+static void switch_event(sim_chip_t *chip, uint32_t pin, bool pressed)
+{
+    if (pressed)
+    {
+        chip->switches |= 1UL << pin;
+    }
+    else
+    {
+        chip->switches &= ~(1UL << pin);
+    }
+    if (chip->powered)
+    {
+        detect_update(chip);
+    }
+}
+
+void sim_switch(sim_chip_t *chip, uint32_t pin, bool pressed, uint64_t time)
+{
+    event_t *event = event_add(time, EVENT_SWITCH, chip);
+
+    event->arg = pin | (pressed ? 0x100 : 0);
+}
+
+// Everything stops but the pin senses, with RAM kept if both blocks are set
+// to be. A rising DETECT resets the chip, as does DETECT already high now.
+void sim_system_off(void)
+{
+    sim_chip_t *chip = running;
+    uint32_t ramon = chip->regs.power.RAMON;
+
+    chip->counts.offs++;
+    chip->retained = (ramon & (1UL << POWER_RAMON_OFFRAM0_Pos)) &&
+                     (ramon & (1UL << POWER_RAMON_OFFRAM1_Pos));
+    chip_stop(chip);
+    chip->off = true;
+    chip->detect = false;
+    detect_update(chip);
+
+    if (chip->in_isr)
+    {
+        longjmp(chip->isr_exit, 1);
+    }
+    swapcontext(&chip->context, &scheduler);
+    fail("%s: ran on in System OFF", chip->image->firmware->name);
+}
+
+/*****************************************************************************/
+/** Clocks */
+/*****************************************************************************/
+
+uint32_t nrf_drv_clock_init(void)
+{
+    return NRF_SUCCESS;
+}
+
+void nrf_drv_clock_lfclk_request(nrf_drv_clock_handler_t handler)
+{
+    if (!running->lf_requested)
+    {
+        running->lf_requested = true;
+        running->lf_start = now + sim_config.lfxo_startup +
+                            sim_random() % (sim_config.lfxo_startup / 10 + 1);
+    }
+}
+
+bool nrf_drv_clock_lfclk_is_running(void)
+{
+    return running->lf_requested && now >= running->lf_start;
+}
+
+// LFCLK cycles since the crystal started
+static uint64_t cycle_now(const sim_chip_t *chip)
+{
+    if (!chip->lf_requested || now < chip->lf_start)
+    {
+        return 0;
+    }
+
+    return (now - chip->lf_start) * 1000 / chip->lf_period;
+}
+
+// When an LFCLK cycle starts
+static uint64_t cycle_time(const sim_chip_t *chip, uint64_t cycle)
+{
+    return chip->lf_start + (cycle * chip->lf_period + 999) / 1000;
+}
+
+/*****************************************************************************/
+/** RTC */
+/*****************************************************************************/
+
+static rtc_t *rtc_of(nrf_drv_rtc_t const * const p_instance)
+{
+    return &running->rtc[p_instance->instance_id];
+}
+
+static uint32_t rtc_count(const sim_chip_t *chip, const rtc_t *rtc)
+{
+    if (!rtc->enabled)
+    {
+        return rtc->base;
+    }
+
+    return (rtc->base + (cycle_now(chip) - rtc->origin) / (rtc->prescaler + 1)) &
+           RTC_COUNTER_COUNTER_Msk;
+}
+
+// Start the counter over from a count, now
+static void rtc_rebase(sim_chip_t *chip, rtc_t *rtc, uint32_t base)
+{
+    rtc->origin = cycle_now(chip);
+    rtc->base = base;
+    for (uint32_t source = 0; source <= NRF_DRV_RTC_INT_OVERFLOW; source++)
+    {
+        rtc->from[source] = rtc->origin;
+    }
+}
+
+// An interrupt source is only due after it is set up
+static void rtc_arm(sim_chip_t *chip, rtc_t *rtc, uint32_t source)
+{
+    uint64_t cycle = cycle_now(chip);
+
+    rtc->from[source] = cycle > rtc->origin ? cycle : rtc->origin;
+}
+
+uint32_t nrf_drv_rtc_init(nrf_drv_rtc_t const * const p_instance,
+                          nrf_drv_rtc_config_t const * p_config,
+                          nrf_drv_rtc_handler_t handler)
+{
+    rtc_t *rtc = rtc_of(p_instance);
+
+    if (rtc->initialised)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    rtc->initialised = true;
+    rtc->prescaler = p_config ? p_config->prescaler : p_instance->prescaler;
+    rtc->handler = handler;
+    NVIC_EnableIRQ(p_instance->irq);
+    return NRF_SUCCESS;
+}
+
+void nrf_drv_rtc_enable(nrf_drv_rtc_t const * const p_instance)
+{
+    rtc_t *rtc = rtc_of(p_instance);
+
+    if (!rtc->enabled)
+    {
+        rtc_rebase(running, rtc, rtc->base);
+        rtc->enabled = true;
+    }
+}
+
+void nrf_drv_rtc_disable(nrf_drv_rtc_t const * const p_instance)
+{
+    rtc_t *rtc = rtc_of(p_instance);
+
+    rtc->base = rtc_count(running, rtc);
+    rtc->enabled = false;
+}
+
+void nrf_drv_rtc_tick_enable(nrf_drv_rtc_t const * const p_instance, bool enable_irq)
+{
+    rtc_t *rtc = rtc_of(p_instance);
+
+    if (!rtc->tick_int)
+    {
+        rtc_arm(running, rtc, NRF_DRV_RTC_INT_TICK);
+    }
+    rtc->tick_int = enable_irq;
+}
+
+void nrf_drv_rtc_tick_disable(nrf_drv_rtc_t const * const p_instance)
+{
+    rtc_of(p_instance)->tick_int = false;
+}
+
+void nrf_drv_rtc_overflow_enable(nrf_drv_rtc_t const * const p_instance, bool enable_irq)
+{
+    rtc_t *rtc = rtc_of(p_instance);
+
+    rtc_arm(running, rtc, NRF_DRV_RTC_INT_OVERFLOW);
+    rtc->overflow_int = enable_irq;
+}
+
+uint32_t nrf_drv_rtc_cc_set(nrf_drv_rtc_t const * const p_instance, uint32_t channel,
+                            uint32_t val, bool enable_irq)
+{
+    rtc_t *rtc = rtc_of(p_instance);
+
+    rtc_arm(running, rtc, channel);
+    rtc->cc[channel] = val & RTC_COUNTER_COUNTER_Msk;
+    rtc->cc_int[channel] = enable_irq;
+    return NRF_SUCCESS;
+}
+
+uint32_t nrf_drv_rtc_cc_disable(nrf_drv_rtc_t const * const p_instance, uint32_t channel)
+{
+    rtc_of(p_instance)->cc_int[channel] = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t nrf_drv_rtc_counter_get(nrf_drv_rtc_t const * const p_instance)
+{
+    return rtc_count(running, rtc_of(p_instance));
+}
+
+void nrf_drv_rtc_counter_clear(nrf_drv_rtc_t const * const p_instance)
+{
+    rtc_t *rtc = rtc_of(p_instance);
+
+    if (rtc->enabled)
+    {
+        rtc_rebase(running, rtc, 0);
+    }
+    else
+    {
+        rtc->base = 0;
+    }
+}
+
+bool nrf_rtc_event_pending(NRF_RTC_Type *p_reg, nrf_rtc_event_t event)
+{
+    return false;
+}
+
+// The first count after a source was last dealt with that it fires at
+static uint64_t rtc_source_next(const rtc_t *rtc, uint32_t source)
+{
+    uint64_t after = (rtc->from[source] - rtc->origin) / (rtc->prescaler + 1) + 1;
+    uint32_t target;
+
+    if (source == NRF_DRV_RTC_INT_TICK)
+    {
+        return after;
+    }
+    target = source == NRF_DRV_RTC_INT_OVERFLOW ? 0 : rtc->cc[source];
+    return after + ((target - rtc->base - after) & RTC_COUNTER_COUNTER_Msk);
+}
+
+static bool rtc_source_enabled(const rtc_t *rtc, uint32_t source)
+{
+    return source <= NRF_DRV_RTC_INT_COMPARE3 ? rtc->cc_int[source] :
+           source == NRF_DRV_RTC_INT_TICK ? rtc->tick_int : rtc->overflow_int;
+}
+
+// When the RTC next interrupts, and which of its sources are due then
+static bool rtc_next(const sim_chip_t *chip, const rtc_t *rtc, uint64_t *cycle, uint32_t *sources)
+{
+    uint64_t first = UINT64_MAX;
+
+    *sources = 0;
+    if (!chip->lf_requested || !rtc->initialised || !rtc->enabled)
+    {
+        return false;
+    }
+
+    for (uint32_t source = 0; source <= NRF_DRV_RTC_INT_OVERFLOW; source++)
+    {
+        uint64_t count;
+
+        if (!rtc_source_enabled(rtc, source))
+        {
+            continue;
+        }
+        count = rtc_source_next(rtc, source);
+        if (count < first)
+        {
+            first = count;
+            *sources = 0;
+        }
+        if (count == first)
+        {
+            *sources |= 1 << source;
+        }
+    }
+
+    *cycle = rtc->origin + first * (rtc->prescaler + 1);
+    return *sources != 0;
+}
+
+/*****************************************************************************/
+/** TIMER */
+/*****************************************************************************/
+
+static uint64_t timer_count(const sim_chip_t *chip, uint32_t id)
+{
+    const timer_state_t *timer = &chip->timer[id];
+    uint64_t count = timer->held;
+
+    if (timer->running)
+    {
+        count += (now - timer->start) * (HFCLK_HZ / 1000000) / SIM_US >> chip->regs.timer[id].PRESCALER;
+    }
+    return count;
+}
+
+// Carry out the tasks written since the TIMER was last looked at
+static void timer_sync(sim_chip_t *chip, uint32_t id)
+{
+    NRF_TIMER_Type *regs = &chip->regs.timer[id];
+    timer_state_t *timer = &chip->timer[id];
+    static const uint32_t masks[] = { 0xFFFF, 0xFF, 0xFFFFFF, 0xFFFFFFFF };
+
+    if (regs->TASKS_CLEAR)
+    {
+        regs->TASKS_CLEAR = 0;
+        timer->held = 0;
+        timer->start = now;
+    }
+    if (regs->TASKS_START)
+    {
+        regs->TASKS_START = 0;
+        if (!timer->running)
+        {
+            timer->running = true;
+            timer->start = now;
+        }
+    }
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        if (regs->TASKS_CAPTURE[i])
+        {
+            regs->TASKS_CAPTURE[i] = 0;
+            regs->CC[i] = timer_count(chip, id) & masks[regs->BITMODE & 3];
+        }
+    }
+    if (regs->TASKS_STOP)
+    {
+        regs->TASKS_STOP = 0;
+        timer->held = timer_count(chip, id);
+        timer->running = false;
+    }
+    if (regs->TASKS_SHUTDOWN)
+    {
+        regs->TASKS_SHUTDOWN = 0;
+        timer->held = 0;
+        timer->running = false;
+    }
+}
+
+NRF_TIMER_Type *sim_timer(uint32_t id)
+{
+    timer_sync(running, id);
+    return &running->regs.timer[id];
+}
+
+/*****************************************************************************/
+/** Gazell */
+/*****************************************************************************/
+
+static bool fifo_push(fifo_t *fifo, const packet_t *packet)
+{
+    if (fifo->count == NRF_GZLL_CONST_FIFO_LENGTH)
+    {
+        return false;
+    }
+    fifo->packet[fifo->count++] = *packet;
+    return true;
+}
+
+static void fifo_pop(fifo_t *fifo)
+{
+    memmove(&fifo->packet[0], &fifo->packet[1], --fifo->count * sizeof(packet_t));
+}
+
+static bool radio_error(nrf_gzll_error_code_t code)
+{
+    nrf_gzll_error_code = code;
+    return false;
+}
+
+// Start on the next packet, if the device has one and isn't sending already.
+// An idle device sends at once, and a packet queued behind another in the
+// timeslot after its last attempt.
+static void radio_start(sim_chip_t *chip)
+{
+    radio_t *radio = &chip->radio;
+    event_t *event;
+
+    if (radio->mode != NRF_GZLL_MODE_DEVICE || !radio->enabled || radio->busy)
+    {
+        return;
+    }
+    for (uint32_t pipe = 0; pipe < PIPES; pipe++)
+    {
+        if (radio->tx[pipe].count)
+        {
+            radio->busy = true;
+            radio->pipe = pipe;
+            radio->attempts = 0;
+            radio->switches = 0;
+            event = event_add(radio->free > now ? radio->free : now, EVENT_ATTEMPT, chip);
+            event->radio_epoch = radio->epoch;
+            return;
+        }
+    }
+}
+
+bool nrf_gzll_init(nrf_gzll_mode_t mode)
+{
+    radio_t *radio = &running->radio;
+
+    memset(radio, 0, sizeof(radio_t));
+    radio->initialised = true;
+    radio->mode = mode;
+    radio->base[0] = 0xE7E7E7E7;
+    radio->base[1] = 0xC2C2C2C2;
+    return true;
+}
+
+bool nrf_gzll_enable(void)
+{
+    radio_t *radio = &running->radio;
+
+    if (!radio->initialised || radio->enabled)
+    {
+        return false;
+    }
+    radio->enabled = true;
+    radio_start(running);
+    return true;
+}
+
+// Takes effect at once, leaving the packet being sent at the head of its FIFO
+void nrf_gzll_disable(void)
+{
+    radio_t *radio = &running->radio;
+
+    radio->enabled = false;
+    radio->busy = false;
+    radio->epoch++;
+}
+
+bool nrf_gzll_is_enabled(void)
+{
+    return running->radio.enabled;
+}
+
+bool nrf_gzll_set_max_tx_attempts(uint16_t max_tx_attempts)
+{
+    running->radio.max_attempts = max_tx_attempts;
+    return true;
+}
+
+static bool radio_set_base(uint32_t index, uint32_t base_address)
+{
+    if (running->radio.enabled)
+    {
+        return false;
+    }
+    running->radio.base[index] = base_address;
+    return true;
+}
+
+bool nrf_gzll_set_base_address_0(uint32_t base_address)
+{
+    return radio_set_base(0, base_address);
+}
+
+bool nrf_gzll_set_base_address_1(uint32_t base_address)
+{
+    return radio_set_base(1, base_address);
+}
+
+bool nrf_gzll_add_packet_to_tx_fifo(uint32_t pipe, uint8_t *payload, uint32_t length)
+{
+    radio_t *radio = &running->radio;
+    packet_t packet;
+
+    if (pipe >= PIPES || length > NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH ||
+        (radio->mode == NRF_GZLL_MODE_DEVICE && !length))
+    {
+        return radio_error(NRF_GZLL_ERROR_CODE_ATTEMPTED_TO_ADD_TO_FULL_FIFO);
+    }
+    memcpy(packet.data, payload, length);
+    packet.length = length;
+    packet.id = radio->next_id[pipe]++;
+    if (!fifo_push(&radio->tx[pipe], &packet))
+    {
+        return radio_error(NRF_GZLL_ERROR_CODE_ATTEMPTED_TO_ADD_TO_FULL_FIFO);
+    }
+    radio_start(running);
+    return true;
+}
+
+bool nrf_gzll_fetch_packet_from_rx_fifo(uint32_t pipe, uint8_t *payload, uint32_t *length)
+{
+    fifo_t *fifo = &running->radio.rx[pipe];
+
+    if (pipe >= PIPES || !fifo->count || *length < fifo->packet[0].length)
+    {
+        return false;
+    }
+    memcpy(payload, fifo->packet[0].data, fifo->packet[0].length);
+    *length = fifo->packet[0].length;
+    fifo_pop(fifo);
+    return true;
+}
+
+int32_t nrf_gzll_get_tx_fifo_packet_count(uint32_t pipe)
+{
+    return pipe < PIPES ? (int32_t)running->radio.tx[pipe].count : -1;
+}
+
+int32_t nrf_gzll_get_rx_fifo_packet_count(uint32_t pipe)
+{
+    return pipe < PIPES ? (int32_t)running->radio.rx[pipe].count : -1;
+}
+
+bool nrf_gzll_flush_tx_fifo(uint32_t pipe)
+{
+    running->radio.tx[pipe].count = 0;
+    return true;
+}
+
+bool nrf_gzll_flush_rx_fifo(uint32_t pipe)
+{
+    running->radio.rx[pipe].count = 0;
+    return true;
+}
+
+nrf_gzll_error_code_t nrf_gzll_get_error_code(void)
+{
+    return nrf_gzll_error_code;
+}
+
+// Put a transmission on air, taking the oldest record's place
+static air_t air_add(uint64_t start, uint64_t length, uint32_t channel)
+{
+    air_t *record = &air[air_next++ % AIR_RECORDS];
+
+    record->start = start;
+    record->end = start + length;
+    record->channel = channel;
+    record->id = ++air_id;
+    return *record;
+}
+
+// True if another transmission overlapped this one on its channel
+static bool air_collided(const air_t *record)
+{
+    for (uint32_t i = 0; i < AIR_RECORDS; i++)
+    {
+        if (air[i].id && air[i].id != record->id && air[i].channel == record->channel &&
+            air[i].start < record->end && record->start < air[i].end)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The device sends its packet in this timeslot
+static void radio_attempt(sim_chip_t *chip)
+{
+    radio_t *radio = &chip->radio;
+    packet_t *packet = &radio->tx[radio->pipe].packet[0];
+    event_t *event;
+
+    // flushed since
+    if (!radio->tx[radio->pipe].count)
+    {
+        radio->busy = false;
+        radio_start(chip);
+        return;
+    }
+
+    radio->attempts++;
+    radio->attempt_start = now;
+    chip->counts.attempts++;
+    radio->air = air_add(now, AIR_TIME(packet->length), radio->channel);
+
+    event = event_add(radio->air.end, EVENT_PACKET_END, chip);
+    event->radio_epoch = radio->epoch;
+}
+
+// Every host listening on the device's address, and not drowned out, takes
+// the packet and starts on its ACK
+static void radio_packet_end(sim_chip_t *chip)
+{
+    radio_t *radio = &chip->radio;
+    uint32_t pipe = radio->pipe;
+    uint32_t base = radio->base[pipe ? 1 : 0];
+    packet_t *packet = &radio->tx[pipe].packet[0];
+    bool collided = air_collided(&radio->air);
+    event_t *event;
+
+    radio->acks = 0;
+    if (collided)
+    {
+        chip->counts.collisions++;
+    }
+
+    for (uint32_t i = 0; i < chip_count && !collided; i++)
+    {
+        sim_chip_t *host = chips[i];
+        radio_t *listener = &host->radio;
+        ack_t *ack = &radio->ack[radio->acks];
+        bool duplicate;
+
+        if (!host->powered || host->off || listener->mode != NRF_GZLL_MODE_HOST ||
+            !listener->enabled || listener->base[pipe ? 1 : 0] != base)
+        {
+            continue;
+        }
+        if (sim_random_unit() < sim_config.loss ||
+            listener->rx[pipe].count == NRF_GZLL_CONST_FIFO_LENGTH)
+        {
+            continue;
+        }
+
+        // a retransmission whose ACK was lost gets the same ACK payload again
+        duplicate = listener->last_valid[pipe] && listener->last[pipe].id == packet->id &&
+                    listener->last[pipe].length == packet->length &&
+                    !memcmp(listener->last[pipe].data, packet->data, packet->length);
+        if (!duplicate)
+        {
+            listener->last[pipe] = *packet;
+            listener->last_valid[pipe] = true;
+            listener->last_ack_valid[pipe] = listener->tx[pipe].count != 0;
+            if (listener->last_ack_valid[pipe])
+            {
+                listener->last_ack[pipe] = listener->tx[pipe].packet[0];
+                fifo_pop(&listener->tx[pipe]);
+            }
+            fifo_push(&listener->rx[pipe], packet);
+
+            event = event_add(now, EVENT_HOST_RX, host);
+            event->arg = pipe;
+        }
+
+        ack->has_payload = listener->last_ack_valid[pipe];
+        ack->payload = listener->last_ack[pipe];
+        ack->air = air_add(now + TURNAROUND,
+                           AIR_TIME(ack->has_payload ? ack->payload.length : 0), radio->channel);
+        radio->acks++;
+    }
+
+    event = event_add(now + ACK_WAIT, EVENT_ACK_END, chip);
+    event->radio_epoch = radio->epoch;
+}
+
+// The device has its ACK, or gives up on this attempt
+static void radio_ack_end(sim_chip_t *chip)
+{
+    radio_t *radio = &chip->radio;
+    uint32_t pipe = radio->pipe;
+    const ack_t *received = NULL;
+    isr_t isr = { .index = pipe };
+    uint32_t collided = 0;
+    event_t *event;
+
+    for (uint32_t i = 0; i < radio->acks; i++)
+    {
+        if (air_collided(&radio->ack[i].air))
+        {
+            chip->counts.collisions++;
+            collided++;
+        }
+        else if (sim_random_unit() >= sim_config.loss)
+        {
+            received = &radio->ack[i];
+        }
+    }
+
+    // the device may still capture one of the colliding ACKs, whichever was
+    // the stronger, which with no distances modelled is any of them
+    if (!received && collided && sim_config.capture > 0 && sim_random_unit() < sim_config.capture)
+    {
+        uint32_t pick = sim_random() % collided;
+
+        for (uint32_t i = 0; i < radio->acks && !received; i++)
+        {
+            if (air_collided(&radio->ack[i].air) && !pick--)
+            {
+                received = &radio->ack[i];
+            }
+        }
+    }
+
+    if (!received && (!radio->max_attempts || radio->attempts < radio->max_attempts))
+    {
+        // next timeslot, hopping channel every few
+        if (radio->attempts % TIMESLOTS_PER_CHANNEL == 0)
+        {
+            radio->channel = (radio->channel + 1) % CHANNELS;
+            radio->switches++;
+        }
+        event = event_add(radio->attempt_start + chip->timeslot +
+                          sim_random() % (sim_config.jitter + 1), EVENT_ATTEMPT, chip);
+        event->radio_epoch = radio->epoch;
+        return;
+    }
+
+    isr.tx_info.num_tx_attempts = radio->attempts;
+    isr.tx_info.num_channel_switches = radio->switches;
+    isr.tx_info.rssi = sim_config.rssi;
+    fifo_pop(&radio->tx[pipe]);
+    radio->busy = false;
+    radio->free = radio->attempt_start + chip->timeslot;
+
+    if (received)
+    {
+        chip->counts.packets++;
+        isr.type = ISR_TX_SUCCESS;
+        isr.tx_info.payload_received_in_ack = received->has_payload &&
+                                              fifo_push(&radio->rx[pipe], &received->payload);
+    }
+    else
+    {
+        chip->counts.failed++;
+        isr.type = ISR_TX_FAILED;
+    }
+
+    isr_run(chip, &isr);
+    if (!chip->off)
+    {
+        radio_start(chip);
+    }
+}
+
+/*****************************************************************************/
+/** UART */
+/*****************************************************************************/
+
+uint32_t nrf_drv_uart_init(nrf_drv_uart_config_t const *p_config,
+                           nrf_uart_event_handler_t event_handler)
+{
+    uart_t *uart = &running->uart;
+    uint64_t baud = p_config->baudrate == NRF_UART_BAUDRATE_1000000 ? 1000000 : 115200;
+
+    if (uart->initialised)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    uart->initialised = true;
+    uart->handler = event_handler;
+    uart->context = p_config->p_context;
+    uart->byte_time = 10 * SIM_S / baud;
+    return NRF_SUCCESS;
+}
+
+uint32_t nrf_drv_uart_tx(uint8_t const * const p_data, uint8_t length)
+{
+    uart_t *uart = &running->uart;
+
+    if (uart->tx_busy)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    uart->tx_busy = true;
+    uart->tx_data = p_data;
+    memcpy(uart->tx, p_data, length);
+    uart->tx_length = length;
+    uart->tx_start = now;
+    event_add(now + length * uart->byte_time, EVENT_UART_TX, running);
+    return NRF_SUCCESS;
+}
+
+uint32_t nrf_drv_uart_rx(uint8_t *p_data, uint8_t length)
+{
+    running->uart.rx_buffer = p_data;
+    return NRF_SUCCESS;
+}
+
+void sim_uart_listen(sim_chip_t *chip, void (*fn)(void *ctx, uint8_t byte, uint64_t time), void *ctx)
+{
+    chip->listener = fn;
+    chip->listener_ctx = ctx;
+}
+
+void sim_uart_send(sim_chip_t *chip, const uint8_t *data, uint32_t length)
+{
+    uart_t *uart = &chip->uart;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        uint64_t start = uart->rx_free > now ? uart->rx_free : now;
+        event_t *event;
+
+        uart->rx_free = start + (uart->byte_time ? uart->byte_time : 10 * SIM_US);
+        event = event_add(uart->rx_free, EVENT_UART_RX, chip);
+        event->arg = data[i];
+    }
+}
+
+static void uart_tx_done(sim_chip_t *chip)
+{
+    uart_t *uart = &chip->uart;
+    isr_t isr = { .type = ISR_UART };
+
+    for (uint32_t i = 0; chip->listener && i < uart->tx_length; i++)
+    {
+        chip->listener(chip->listener_ctx, uart->tx[i], uart->tx_start + (i + 1) * uart->byte_time);
+    }
+    uart->tx_busy = false;
+    isr.uart.type = NRF_DRV_UART_EVT_TX_DONE;
+    isr.uart.data.rxtx.p_data = (uint8_t *)uart->tx_data;
+    isr.uart.data.rxtx.bytes = uart->tx_length;
+    isr_run(chip, &isr);
+}
+
+static void uart_rx_byte(sim_chip_t *chip, uint8_t byte)
+{
+    uart_t *uart = &chip->uart;
+    isr_t isr = { .type = ISR_UART };
+
+    if (!uart->initialised || !uart->rx_buffer)
+    {
+        chip->counts.uart_overruns++;
+        return;
+    }
+    image_load(chip);
+    *uart->rx_buffer = byte;
+    uart->rx_buffer = NULL;
+    isr.uart.type = NRF_DRV_UART_EVT_RX_DONE;
+    isr.uart.data.rxtx.p_data = &byte;
+    isr.uart.data.rxtx.bytes = 1;
+    isr_run(chip, &isr);
+}
+
+/*****************************************************************************/
+/** Scheduler */
+/*****************************************************************************/
+
+// Start main, and run whatever the chip has pending, until it sleeps with
+// nothing left to do
+static void settle(sim_chip_t *chip)
+{
+    for (uint32_t passes = 0; chip->powered && !chip->off; passes++)
+    {
+        if (passes > 100000)
+        {
+            fail("%s: interrupts never let up", chip->image->firmware->name);
+        }
+
+        if (!chip->started)
+        {
+            if (!chip->booted)
+            {
+                return;
+            }
+            run_main(chip);
+        }
+        else if (gpiote_pending(chip))
+        {
+            isr_run(chip, &(isr_t){ .type = ISR_GPIOTE });
+        }
+        else if (chip->sleeping && chip->event)
+        {
+            run_main(chip);
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+// An event for a chip, unless a reset or power loss since has retired it
+static void dispatch(const event_t *event)
+{
+    sim_chip_t *chip = event->chip;
+
+    if (event->type == EVENT_CALL)
+    {
+        event->fn(event->ctx);
+        return;
+    }
+    if (event->type == EVENT_SWITCH)
+    {
+        switch_event(chip, event->arg & 0xFF, event->arg & 0x100);
+        return;
+    }
+    if (!chip->powered || event->epoch != chip->epoch)
+    {
+        return;
+    }
+
+    switch (event->type)
+    {
+    case EVENT_BOOT:
+        chip->booted = true;
+        break;
+    case EVENT_WAKE:
+        if (chip->off)
+        {
+            chip_reset(chip, POWER_RESETREAS_OFF_Msk);
+        }
+        break;
+    case EVENT_ATTEMPT:
+    case EVENT_PACKET_END:
+    case EVENT_ACK_END:
+        if (event->radio_epoch != chip->radio.epoch || !chip->radio.enabled)
+        {
+            break;
+        }
+        if (event->type == EVENT_ATTEMPT)
+        {
+            radio_attempt(chip);
+        }
+        else if (event->type == EVENT_PACKET_END)
+        {
+            radio_packet_end(chip);
+        }
+        else
+        {
+            radio_ack_end(chip);
+        }
+        break;
+    case EVENT_HOST_RX:
+        isr_run(chip, &(isr_t){ .type = ISR_RX_DATA_READY, .index = event->arg,
+                                .rx_info = { .packet_received = true, .rssi = sim_config.rssi } });
+        break;
+    case EVENT_UART_TX:
+        uart_tx_done(chip);
+        break;
+    case EVENT_UART_RX:
+        uart_rx_byte(chip, event->arg);
+        break;
+    default:
+        break;
+    }
+}
+
+static void settle_all(void)
+{
+    for (uint32_t i = 0; i < chip_count; i++)
+    {
+        settle(chips[i]);
+    }
+}
+
+void sim_run_until(uint64_t time)
+{
+    settle_all();
+    while (true)
+    {
+        sim_chip_t *rtc_chip = NULL;
+        uint32_t rtc_index = 0, rtc_sources = 0;
+        uint64_t rtc_cycle = 0, rtc_time = UINT64_MAX;
+
+        // the RTCs first, as their interrupts are due at the start of the cycle
+        for (uint32_t i = 0; i < chip_count; i++)
+        {
+            sim_chip_t *chip = chips[i];
+
+            for (uint32_t r = 0; chip->powered && !chip->off && chip->started && r < 2; r++)
+            {
+                uint64_t cycle;
+                uint32_t sources;
+
+                if (rtc_next(chip, &chip->rtc[r], &cycle, &sources) &&
+                    cycle_time(chip, cycle) < rtc_time)
+                {
+                    rtc_time = cycle_time(chip, cycle);
+                    rtc_cycle = cycle;
+                    rtc_chip = chip;
+                    rtc_index = r;
+                    rtc_sources = sources;
+                }
+            }
+        }
+
+        if (rtc_chip && rtc_time <= time && (!event_count || rtc_time <= events[0].time))
+        {
+            rtc_t *rtc = &rtc_chip->rtc[rtc_index];
+
+            now = rtc_time > now ? rtc_time : now;
+            for (uint32_t source = 0; source <= NRF_DRV_RTC_INT_OVERFLOW; source++)
+            {
+                if (rtc_sources & (1 << source))
+                {
+                    rtc->from[source] = rtc_cycle;
+                }
+            }
+            isr_run(rtc_chip, &(isr_t){ .type = ISR_RTC, .index = rtc_index, .sources = rtc_sources });
+        }
+        else if (event_count && events[0].time <= time)
+        {
+            event_t event = event_pop();
+
+            now = event.time;
+            dispatch(&event);
+        }
+        else
+        {
+            break;
+        }
+        settle_all();
+    }
+    if (time > now)
+    {
+        now = time;
+    }
+}
+
+void sim_run(uint64_t duration)
+{
+    sim_run_until(now + duration);
+}
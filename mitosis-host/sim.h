@@ -0,0 +1,136 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nrf.h"
+#include "nrf_gzll.h"
+
+// Simulator running the unmodified firmware of the halves and the receiver
+// on the host, against the stub SDK in sdk/. Each chip is a firmware image
+// with its own registers, RAM and flash. Its main loop runs as a coroutine
+// that gives the host CPU back when it sleeps in __WFE, and its interrupts
+// run to completion from the scheduler, only while it sleeps.
+//
+// Firmware runs in no simulated time. Time passes only in the peripherals:
+// - RTCs counting the 32kHz crystal through their prescalers, from when the
+//   crystal has started, each chip's crystals a little off in their own way
+// - GPIO with the switches pulling their pins low, and the sense mechanism
+//   raising the PORT event or waking from System OFF
+// - Gazell with a timeslot per attempt, on air times at 2Mbps, ACK payloads,
+//   lost packets and ACKs, collisions between radios on the same channel, and
+//   optionally one of the ACKs colliding on a device still getting through
+// - the UART at its baud rate, 10 bits a byte
+// - TIMERs counting the 16MHz clock
+
+// Simulated time, nanoseconds since sim_init()
+#define SIM_US  1000ULL
+#define SIM_MS  1000000ULL
+#define SIM_S   1000000000ULL
+
+// A range of memory in a firmware image
+typedef struct
+{
+    uint8_t *start;
+    uint8_t *stop;
+} sim_region_t;
+
+// What chip.c, built into every image, tells the simulator about it
+typedef struct
+{
+    const char *name;
+    int (*main)(void);
+    void (*gpiote_irq)(void);
+    void (*tx_success)(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info);
+    void (*tx_failed)(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info);
+    void (*rx_data_ready)(uint32_t pipe, nrf_gzll_host_rx_info_t rx_info);
+    sim_region_t data;          ///< set from the image at every reset
+    sim_region_t bss;           ///< cleared at every reset
+    sim_region_t noinit;        ///< left alone by resets, random from power on
+    sim_region_t flash;         ///< the pairing page, erased until written
+} sim_firmware_t;
+
+#define SIM_FIRMWARE(name) extern const sim_firmware_t name##_firmware
+
+typedef struct sim_chip sim_chip_t;
+
+// Settings for the next sim_init()
+typedef struct
+{
+    uint64_t seed;              ///< for packet loss and anything else random
+    double loss;                ///< chance of losing each packet, and each ACK, on air
+    int8_t rssi;                ///< signal strength every packet arrives with
+    uint64_t lfxo_startup;      ///< from requesting the 32kHz crystal to the RTCs counting, give or take 10%
+    uint64_t boot;              ///< from a reset to main starting
+    double ppm;                 ///< crystal tolerance, each chip's clocks are off by up to this
+    uint64_t jitter;            ///< Gazell retries start up to this late, as a real radio's
+                                ///< timing wanders, without which two devices that collide
+                                ///< once keep colliding in step
+    double capture;             ///< chance a device still makes out one of the ACKs colliding
+                                ///< on it, as the stronger of two radios often wins. 0 has
+                                ///< every collision lose them all, as signal strengths
+                                ///< aren't modelled.
+} sim_config_t;
+
+extern sim_config_t sim_config;
+
+// Counts kept for each chip, for tests to check
+typedef struct
+{
+    uint32_t attempts;          ///< Gazell transmissions, retries included
+    uint32_t packets;           ///< acknowledged
+    uint32_t failed;            ///< given up on after the last attempt
+    uint32_t collisions;        ///< transmissions lost to another on the same channel
+    uint32_t resets;            ///< resets, power on included
+    uint32_t offs;              ///< entries to System OFF
+    uint32_t isrs;              ///< interrupts run
+    uint32_t uart_overruns;     ///< bytes received with no read waiting
+} sim_counts_t;
+
+// Start over, with no chips, at time 0
+void sim_init(void);
+
+// Add a chip running an image, with its FICR device ID. Each chip has its own
+// RAM and flash, so the same image can run on several.
+sim_chip_t *sim_chip(const sim_firmware_t *firmware, uint32_t device_id);
+
+// Apply power to a chip, it starts from reset with its flash as it is
+void sim_power_on(sim_chip_t *chip);
+
+// Take power away, so the chip does nothing until powered on again
+void sim_power_off(sim_chip_t *chip);
+
+// Run until the given time, or for a duration
+void sim_run_until(uint64_t time);
+void sim_run(uint64_t duration);
+uint64_t sim_now(void);
+
+// Call fn(ctx) at a time, from the scheduler, not from any chip
+void sim_at(uint64_t time, void (*fn)(void *ctx), void *ctx);
+
+// Press or release the switch on a pin, at a time
+void sim_switch(sim_chip_t *chip, uint32_t pin, bool pressed, uint64_t time);
+
+// The level the chip drives an output pin to
+bool sim_pin_out(const sim_chip_t *chip, uint32_t pin);
+
+// True while the chip is in System OFF
+bool sim_system_is_off(const sim_chip_t *chip);
+
+// The chip's pairing page of flash, to set up or inspect while it isn't running
+uint32_t *sim_flash(sim_chip_t *chip);
+
+const sim_counts_t *sim_counts(const sim_chip_t *chip);
+
+// Bytes into the chip's UART, one after another from now
+void sim_uart_send(sim_chip_t *chip, const uint8_t *data, uint32_t length);
+
+// Called with every byte the chip's UART sends, and when its stop bit ends
+void sim_uart_listen(sim_chip_t *chip, void (*fn)(void *ctx, uint8_t byte, uint64_t time),
+                     void *ctx);
+
+// Uniform random numbers from the simulation's generator
+uint32_t sim_random(void);
+double sim_random_unit(void);
+
+#endif
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "debounce.h"
+
+// Built twice, debouncing per key and the whole matrix, see the Makefile.
+// Types on bouncing switches, one sample a tick, and reports how many ticks
+// each press and release took to get through the debounce, counting the
+// tick it was first seen on, as edge_ticks does. Transitions that never got
+// through are missed, and any that came through unasked for are phantoms.
+// Latencies are in ticks, so milliseconds at the firmware's 1kHz sampling.
+
+#define KEYS    24          ///< as many switches as a half has
+#define WORN    (KEYS - 1)  ///< a switch never typed on, that may chatter by itself
+#define TAPS    20000
+
+typedef struct
+{
+    const char *name;
+    uint32_t bounce;        ///< ticks each edge may bounce for
+    bool worn;              ///< the worn switch makes contact for a tick now and then
+} run_t;
+
+typedef struct
+{
+    const char *name;
+    uint8_t mode, press, release;
+} profile_t;
+
+static uint64_t state = 88172645463325252ULL;
+
+static uint32_t random32(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state >> 32;
+}
+
+static int compare(const void *a, const void *b)
+{
+    return (int)(*(const uint32_t *)a) - (int)(*(const uint32_t *)b);
+}
+
+// Percentiles of a sorted set of latencies
+static void print_latencies(const char *name, uint32_t *latencies, uint32_t count)
+{
+    qsort(latencies, count, sizeof(latencies[0]), compare);
+    printf("  %s p50 %2u p99 %2u max %2u", name, latencies[count / 2],
+           latencies[count * 99 / 100], latencies[count - 1]);
+}
+
+static void bench(const profile_t *profile, const run_t *run)
+{
+    static uint32_t latencies[2][TAPS];
+    uint32_t count[2] = {0}, missed = 0, phantoms = 0;
+    uint32_t next_tap = 0, taps = 0;
+    uint32_t edge[KEYS] = {0};      // tick of each key's last edge
+    uint32_t release[KEYS] = {0};   // tick each held key is let go on
+    uint32_t pending = 0;           // keys whose last edge is still to get through
+    uint32_t held = 0;
+    debounce_t deb;
+
+    debounce_init(&deb);
+    debounce_profile(&deb, profile->mode, profile->press, profile->release);
+
+    for (uint32_t tick = 1; taps < TAPS || held || pending; tick++)
+    {
+        uint32_t sample = 0, changed;
+        bool bouncing;
+
+        // a tap every 40 to 160 ticks, about 120wpm at a tick a millisecond,
+        // on a key that has been let go for a while, held for 40 to 120
+        if (taps < TAPS && tick >= next_tap)
+        {
+            uint32_t key = random32() % WORN;
+
+            if (!(held & (1UL << key)) && tick - edge[key] > 30)
+            {
+                missed += !!(pending & (1UL << key));
+                held |= 1UL << key;
+                pending |= 1UL << key;
+                edge[key] = tick;
+                release[key] = tick + 40 + random32() % 80;
+                taps++;
+            }
+            next_tap = tick + 40 + random32() % 120;
+        }
+
+        for (uint32_t key = 0; key < WORN; key++)
+        {
+            if ((held & (1UL << key)) && tick == release[key])
+            {
+                missed += !!(pending & (1UL << key));
+                held &= ~(1UL << key);
+                pending |= 1UL << key;
+                edge[key] = tick;
+            }
+
+            // either way at random while bouncing, then where it was put
+            bouncing = edge[key] && tick - edge[key] < run->bounce;
+            if (bouncing ? random32() & 1 : held & (1UL << key))
+            {
+                sample |= 1UL << key;
+            }
+        }
+        if (run->worn && random32() % 30 == 0)
+        {
+            sample |= 1UL << WORN;
+        }
+
+        changed = debounce_tick(&deb, sample);
+        for (uint32_t key = 0; changed; key++)
+        {
+            if (!(changed & (1UL << key)))
+            {
+                continue;
+            }
+            changed &= ~(1UL << key);
+
+            if ((pending & (1UL << key)) && !(deb.keys & (1UL << key)) == !(held & (1UL << key)))
+            {
+                bool pressed = deb.keys & (1UL << key);
+
+                pending &= ~(1UL << key);
+                latencies[pressed][count[pressed]++] = tick - edge[key] + 1;
+            }
+            else
+            {
+                phantoms++;
+            }
+        }
+    }
+
+    printf("%-7s %-10s %-12s", DEBOUNCE_PER_KEY ? "per key" : "matrix", profile->name, run->name);
+    print_latencies("press", latencies[1], count[1]);
+    print_latencies("  release", latencies[0], count[0]);
+    printf("  missed %u  phantoms %u  bounces %u\n", missed, phantoms, deb.bounces);
+}
+
+int main(void)
+{
+    static const profile_t profiles[] = {
+        { "defer 5",     DEBOUNCE_DEFER, 5, 5 },
+        { "asym 2/5",    DEBOUNCE_ASYM,  2, 5 },
+        { "eager 5/5",   DEBOUNCE_EAGER, 5, 5 },
+    };
+    static const run_t runs[] = {
+        { "clean",       0, false },
+        { "2ms bounce",  2, false },
+        { "5ms bounce",  5, false },
+        { "worn switch", 2, true },
+    };
+
+    for (uint32_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+    {
+        for (uint32_t j = 0; j < sizeof(runs) / sizeof(runs[0]); j++)
+        {
+            bench(&profiles[i], &runs[j]);
+        }
+    }
+    return 0;
+}
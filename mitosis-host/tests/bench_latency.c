@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include "board.h"
+
+// Replays typing on a whole board, reporting the latency from each switch
+// moving to the frame QMK reads it from, and the keystrokes that never got
+// there. Each run types the same text, with its own speed, chatter and link.
+
+static const char text[] =
+    "the quick brown fox jumps over the lazy dog while a zebra waves back "
+    "pack my box with five dozen liquor jugs and sphinx of black quartz judge my vow "
+    "we were expecting about seventy people to turn up for the opening but by nine "
+    "the hall was full and the doors had to be closed as the crowd kept on growing";
+
+// Where each character is typed, by hand, on a QWERTY-like layout
+static const char left[] = "qwertasdfgzxcvb";
+static const char right[] = "yuiophjkl;nm,./ ";
+
+static board_t board;
+
+typedef struct
+{
+    const char *name;
+    uint32_t wpm;
+    uint64_t bounce;
+    double loss;
+    bool framed;
+    bool polled;                    ///< QMK polling with 's' every scan, not streaming
+} run_t;
+
+static bool locate(char c, uint32_t *side, uint32_t *key)
+{
+    const char *at;
+
+    if ((at = strchr(left, c)) != NULL)
+    {
+        *side = BOARD_LEFT;
+        *key = at - left;
+        return true;
+    }
+    if ((at = strchr(right, c)) != NULL)
+    {
+        *side = BOARD_RIGHT;
+        *key = at - right;
+        return true;
+    }
+    return false;
+}
+
+static void replay(const run_t *run)
+{
+    uint64_t released[2][BOARD_KEYS] = {{0}};
+    uint64_t interval = 60 * SIM_S / (run->wpm * 5);
+    uint64_t time;
+
+    sim_config.loss = 0;
+    sim_init();
+    board_init(&board, 0x1000, true);
+    board_power_on(&board);
+    sim_run(SIM_S);
+    if (run->polled)
+    {
+        board_poll(&board, BOARD_QMK_SCAN);
+    }
+    else
+    {
+        board_stream(&board, run->framed);
+    }
+    sim_run(10 * SIM_MS);
+    sim_config.loss = run->loss;
+
+    // each character some way either side of the typing speed, held for long
+    // enough to overlap the next at speed, as rolls do
+    time = sim_now();
+    for (uint32_t i = 0; text[i]; i++)
+    {
+        uint64_t hold = 70 * SIM_MS + sim_random() % (40 * SIM_MS);
+        uint32_t side, key;
+
+        if (!locate(text[i], &side, &key))
+        {
+            continue;
+        }
+        if (time < released[side][key] + 50 * SIM_MS)
+        {
+            time = released[side][key] + 50 * SIM_MS;
+        }
+        sim_run_until(time);
+        board_tap(&board, side, key, time, hold, run->bounce);
+        released[side][key] = time + hold;
+        time += interval * 6 / 10 + sim_random() % (interval * 8 / 10);
+    }
+    sim_run_until(time + 10 * SIM_S);
+    sim_config.loss = 0;
+
+    board_report(&board, run->name);
+}
+
+int main(void)
+{
+    static const run_t runs[] = {
+        { "60wpm",                60, 2 * SIM_MS, 0,    true,  false },
+        { "60wpm polled",         60, 2 * SIM_MS, 0,    false, true },
+        { "120wpm",              120, 2 * SIM_MS, 0,    true,  false },
+        { "120wpm legacy frames", 120, 2 * SIM_MS, 0,    false, false },
+        { "120wpm polled",       120, 2 * SIM_MS, 0,    false, true },
+        { "120wpm clean switches", 120, 0,         0,    true,  false },
+        { "120wpm 5ms chatter",  120, 5 * SIM_MS, 0,    true,  false },
+        { "120wpm 10% loss",     120, 2 * SIM_MS, 0.1,  true,  false },
+        { "120wpm 10% loss polled", 120, 2 * SIM_MS, 0.1, false, true },
+    };
+
+    for (uint32_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++)
+    {
+        replay(&runs[i]);
+    }
+    return 0;
+}
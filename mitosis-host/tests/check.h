@@ -0,0 +1,40 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+// Just enough of a test framework: checks report where they failed and carry
+// on, and check_done() gives the exit status
+
+static unsigned check_failures;
+
+#define CHECK(condition)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!(condition))                                                       \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+            check_failures++;                                                   \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQUAL(actual, expected)                                           \
+    do                                                                          \
+    {                                                                           \
+        long long check_actual = (long long)(actual);                           \
+        long long check_expected = (long long)(expected);                       \
+        if (check_actual != check_expected)                                     \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: failed: %s is %lld, expected %lld\n",       \
+                    __FILE__, __LINE__, #actual, check_actual, check_expected); \
+            check_failures++;                                                   \
+        }                                                                       \
+    } while (0)
+
+static inline int check_done(const char *name)
+{
+    printf("%s: %s\n", name, check_failures ? "FAILED" : "ok");
+    return check_failures != 0;
+}
+
+#endif
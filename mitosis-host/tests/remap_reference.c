@@ -0,0 +1,140 @@
+#include <string.h>
+#include "remap_reference.h"
+#include "mitosis.h"
+#include "mitosis_matrix.h"
+#include "keystates.h"
+
+#define LEFT_PIN_MAP(pin)   PIN_WIRE_MAP(L_S, pin)
+#define RIGHT_PIN_MAP(pin)  PIN_WIRE_MAP(R_S, pin)
+
+static const uint32_t left_pin_lut[8][16] = NIBBLE_LUT_32(LEFT_PIN_MAP);
+static const uint32_t right_pin_lut[8][16] = NIBBLE_LUT_32(RIGHT_PIN_MAP);
+
+// Copied from the original firmware, with the switch pins of either half
+
+#define PACK(S) \
+    data_payload[0] = ((keys & 1<<S##01) ? 1:0) << 7 | \
+                      ((keys & 1<<S##02) ? 1:0) << 6 | \
+                      ((keys & 1<<S##03) ? 1:0) << 5 | \
+                      ((keys & 1<<S##04) ? 1:0) << 4 | \
+                      ((keys & 1<<S##05) ? 1:0) << 3 | \
+                      ((keys & 1<<S##06) ? 1:0) << 2 | \
+                      ((keys & 1<<S##07) ? 1:0) << 1 | \
+                      ((keys & 1<<S##08) ? 1:0) << 0;  \
+                                                       \
+    data_payload[1] = ((keys & 1<<S##09) ? 1:0) << 7 | \
+                      ((keys & 1<<S##10) ? 1:0) << 6 | \
+                      ((keys & 1<<S##11) ? 1:0) << 5 | \
+                      ((keys & 1<<S##12) ? 1:0) << 4 | \
+                      ((keys & 1<<S##13) ? 1:0) << 3 | \
+                      ((keys & 1<<S##14) ? 1:0) << 2 | \
+                      ((keys & 1<<S##15) ? 1:0) << 1 | \
+                      ((keys & 1<<S##16) ? 1:0) << 0;  \
+                                                       \
+    data_payload[2] = ((keys & 1<<S##17) ? 1:0) << 7 | \
+                      ((keys & 1<<S##18) ? 1:0) << 6 | \
+                      ((keys & 1<<S##19) ? 1:0) << 5 | \
+                      ((keys & 1<<S##20) ? 1:0) << 4 | \
+                      ((keys & 1<<S##21) ? 1:0) << 3 | \
+                      ((keys & 1<<S##22) ? 1:0) << 2 | \
+                      ((keys & 1<<S##23) ? 1:0) << 1 | \
+                      0 << 0;
+
+void reference_pack(bool left, uint32_t keys, uint8_t *data_payload)
+{
+    if (left)
+    {
+        PACK(L_S)
+    }
+    else
+    {
+        PACK(R_S)
+    }
+}
+
+void reference_unpack(bool left, const uint8_t *data_payload, uint8_t *data_buffer)
+{
+    if (left)
+    {
+        data_buffer[0] = ((data_payload[0] & 1<<3) ? 1:0) << 0 |
+                         ((data_payload[0] & 1<<4) ? 1:0) << 1 |
+                         ((data_payload[0] & 1<<5) ? 1:0) << 2 |
+                         ((data_payload[0] & 1<<6) ? 1:0) << 3 |
+                         ((data_payload[0] & 1<<7) ? 1:0) << 4;
+
+        data_buffer[2] = ((data_payload[1] & 1<<6) ? 1:0) << 0 |
+                         ((data_payload[1] & 1<<7) ? 1:0) << 1 |
+                         ((data_payload[0] & 1<<0) ? 1:0) << 2 |
+                         ((data_payload[0] & 1<<1) ? 1:0) << 3 |
+                         ((data_payload[0] & 1<<2) ? 1:0) << 4;
+
+        data_buffer[4] = ((data_payload[1] & 1<<1) ? 1:0) << 0 |
+                         ((data_payload[1] & 1<<2) ? 1:0) << 1 |
+                         ((data_payload[1] & 1<<3) ? 1:0) << 2 |
+                         ((data_payload[1] & 1<<4) ? 1:0) << 3 |
+                         ((data_payload[1] & 1<<5) ? 1:0) << 4;
+
+        data_buffer[6] = ((data_payload[2] & 1<<5) ? 1:0) << 1 |
+                         ((data_payload[2] & 1<<6) ? 1:0) << 2 |
+                         ((data_payload[2] & 1<<7) ? 1:0) << 3 |
+                         ((data_payload[1] & 1<<0) ? 1:0) << 4;
+
+        data_buffer[8] = ((data_payload[2] & 1<<1) ? 1:0) << 1 |
+                         ((data_payload[2] & 1<<2) ? 1:0) << 2 |
+                         ((data_payload[2] & 1<<3) ? 1:0) << 3 |
+                         ((data_payload[2] & 1<<4) ? 1:0) << 4;
+    }
+    else
+    {
+        data_buffer[1] = ((data_payload[0] & 1<<7) ? 1:0) << 0 |
+                         ((data_payload[0] & 1<<6) ? 1:0) << 1 |
+                         ((data_payload[0] & 1<<5) ? 1:0) << 2 |
+                         ((data_payload[0] & 1<<4) ? 1:0) << 3 |
+                         ((data_payload[0] & 1<<3) ? 1:0) << 4;
+
+        data_buffer[3] = ((data_payload[0] & 1<<2) ? 1:0) << 0 |
+                         ((data_payload[0] & 1<<1) ? 1:0) << 1 |
+                         ((data_payload[0] & 1<<0) ? 1:0) << 2 |
+                         ((data_payload[1] & 1<<7) ? 1:0) << 3 |
+                         ((data_payload[1] & 1<<6) ? 1:0) << 4;
+
+        data_buffer[5] = ((data_payload[1] & 1<<5) ? 1:0) << 0 |
+                         ((data_payload[1] & 1<<4) ? 1:0) << 1 |
+                         ((data_payload[1] & 1<<3) ? 1:0) << 2 |
+                         ((data_payload[1] & 1<<2) ? 1:0) << 3 |
+                         ((data_payload[1] & 1<<1) ? 1:0) << 4;
+
+        data_buffer[7] = ((data_payload[1] & 1<<0) ? 1:0) << 0 |
+                         ((data_payload[2] & 1<<7) ? 1:0) << 1 |
+                         ((data_payload[2] & 1<<6) ? 1:0) << 2 |
+                         ((data_payload[2] & 1<<5) ? 1:0) << 3;
+
+        data_buffer[9] = ((data_payload[2] & 1<<4) ? 1:0) << 0 |
+                         ((data_payload[2] & 1<<3) ? 1:0) << 1 |
+                         ((data_payload[2] & 1<<2) ? 1:0) << 2 |
+                         ((data_payload[2] & 1<<1) ? 1:0) << 3;
+    }
+}
+
+void table_pack(bool left, uint32_t keys, uint8_t *data_payload)
+{
+    uint32_t wire = lut_remap(left ? left_pin_lut : right_pin_lut, keys, 8);
+
+    data_payload[0] = wire >> 16;
+    data_payload[1] = wire >> 8;
+    data_payload[2] = wire;
+}
+
+void table_unpack(bool left, const uint8_t *data_payload, uint8_t *data_buffer)
+{
+    static half_t halves[2];
+    half_t *half = &halves[left ? SIDE_LEFT : SIDE_RIGHT];
+
+    // set up the once, so only the remap is timed
+    if (half->side != (left ? SIDE_LEFT : SIDE_RIGHT) || !half->timeout)
+    {
+        keystates_init(half, left ? SIDE_LEFT : SIDE_RIGHT);
+    }
+    memcpy(half->keys, data_payload, BITMAP_LENGTH);
+    keystates_unpack(half, data_buffer);
+}
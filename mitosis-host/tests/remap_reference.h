@@ -0,0 +1,22 @@
+#ifndef REMAP_REFERENCE_H
+#define REMAP_REFERENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The shift and mask remaps of the original firmware, that the lookup tables
+// of mitosis_matrix.h replaced, kept to check and time the tables against
+
+// Pack a half's switch pins into the payload bitmap, as the halves did
+void reference_pack(bool left, uint32_t keys, uint8_t *data_payload);
+
+// Unpack a half's payload bitmap into its rows of data_buffer, as the
+// receiver did
+void reference_unpack(bool left, const uint8_t *data_payload, uint8_t *data_buffer);
+
+// The same through the lookup tables, as the firmware does now, with the
+// pin table of main.c and keystates_unpack()
+void table_pack(bool left, uint32_t keys, uint8_t *data_payload);
+void table_unpack(bool left, const uint8_t *data_payload, uint8_t *data_buffer);
+
+#endif
@@ -0,0 +1,190 @@
+#include "check.h"
+#include "debounce.h"
+
+// Built twice, debouncing per key and the whole matrix, see the Makefile
+
+#define KEY_A   (1UL << 3)
+#define KEY_B   (1UL << 9)
+
+// Feed the same sample for a number of ticks, returning the changes
+static uint32_t run(debounce_t *deb, uint32_t sample, uint32_t ticks)
+{
+    uint32_t changed = 0;
+
+    while (ticks--)
+    {
+        changed |= debounce_tick(deb, sample);
+    }
+    return changed;
+}
+
+// A clean press goes out on the window + 1'th sample, as does its release
+static void test_defer(void)
+{
+    debounce_t deb;
+
+    debounce_init(&deb);
+    debounce_profile(&deb, DEBOUNCE_DEFER, 5, 5);
+
+    CHECK_EQUAL(run(&deb, KEY_A, 5), 0);
+    CHECK_EQUAL(debounce_tick(&deb, KEY_A), KEY_A);
+    CHECK_EQUAL(deb.edge_ticks, 6);
+    CHECK_EQUAL(deb.keys, KEY_A);
+    CHECK(!debounce_pending(&deb));
+
+    CHECK_EQUAL(run(&deb, 0, 5), 0);
+    CHECK_EQUAL(debounce_tick(&deb, 0), KEY_A);
+    CHECK_EQUAL(deb.keys, 0);
+}
+
+// Chatter shorter than the window is never sent
+static void test_bounce(void)
+{
+    debounce_t deb;
+
+    debounce_init(&deb);
+    debounce_profile(&deb, DEBOUNCE_DEFER, 5, 5);
+
+    CHECK_EQUAL(run(&deb, KEY_A, 2), 0);
+    CHECK_EQUAL(run(&deb, 0, 10), 0);
+    CHECK_EQUAL(deb.keys, 0);
+    CHECK_EQUAL(deb.bounces, 1);
+    CHECK(!debounce_pending(&deb));
+
+    // and a bounce in the middle of a press restarts its window
+    CHECK_EQUAL(run(&deb, KEY_A, 3), 0);
+    CHECK_EQUAL(run(&deb, 0, 1), 0);
+    CHECK_EQUAL(run(&deb, KEY_A, 5), 0);
+    CHECK_EQUAL(debounce_tick(&deb, KEY_A), KEY_A);
+}
+
+// Asymmetric windows, a short press and a long release
+static void test_asym(void)
+{
+    debounce_t deb;
+
+    debounce_init(&deb);
+    debounce_profile(&deb, DEBOUNCE_ASYM, 2, 8);
+
+    CHECK_EQUAL(run(&deb, KEY_A, 2), 0);
+    CHECK_EQUAL(debounce_tick(&deb, KEY_A), KEY_A);
+    CHECK_EQUAL(run(&deb, 0, 8), 0);
+    CHECK_EQUAL(debounce_tick(&deb, 0), KEY_A);
+}
+
+// Eager presses go out on the first sample, then ignore the switch while
+// locked, releases wait out their window
+static void test_eager(void)
+{
+    debounce_t deb;
+
+    debounce_init(&deb);
+    debounce_profile(&deb, DEBOUNCE_EAGER, 5, 5);
+
+    CHECK_EQUAL(debounce_tick(&deb, KEY_A), KEY_A);
+    CHECK_EQUAL(deb.edge_ticks, 1);
+    CHECK_EQUAL(run(&deb, 0, 2), 0);
+    CHECK_EQUAL(run(&deb, KEY_A, 10), 0);
+    CHECK_EQUAL(deb.keys, KEY_A);
+    CHECK(!debounce_pending(&deb));
+
+    CHECK_EQUAL(run(&deb, 0, 5), 0);
+    CHECK_EQUAL(debounce_tick(&deb, 0), KEY_A);
+    CHECK_EQUAL(deb.keys, 0);
+}
+
+// Windows out of range are clamped, so a lock of 0 doesn't hold a key
+// until its counter wraps around
+static void test_profile(void)
+{
+    debounce_t deb;
+
+    debounce_init(&deb);
+    debounce_profile(&deb, DEBOUNCE_EAGER, 0, 0);
+    CHECK_EQUAL(deb.press, 1);
+    CHECK_EQUAL(deb.release, 1);
+
+    CHECK_EQUAL(debounce_tick(&deb, KEY_A), KEY_A);
+    CHECK_EQUAL(debounce_tick(&deb, KEY_A), 0);
+    CHECK_EQUAL(run(&deb, 0, 2), KEY_A);
+    CHECK_EQUAL(deb.keys, 0);
+
+    debounce_profile(&deb, DEBOUNCE_ASYM, 200, 15);
+#if DEBOUNCE_PER_KEY
+    CHECK_EQUAL(deb.press, DEBOUNCE_MAX);
+    CHECK_EQUAL(deb.release, DEBOUNCE_MAX);
+#else
+    CHECK_EQUAL(deb.press, 200);
+    CHECK_EQUAL(deb.release, 15);
+#endif
+}
+
+// One key chattering doesn't hold up another, debounced per key
+static void test_independent(void)
+{
+    debounce_t deb;
+    uint32_t changed = 0;
+
+    debounce_init(&deb);
+    debounce_profile(&deb, DEBOUNCE_DEFER, 5, 5);
+
+    for (uint32_t tick = 0; tick < 6; tick++)
+    {
+        changed |= debounce_tick(&deb, KEY_A | ((tick & 1) ? KEY_B : 0));
+    }
+#if DEBOUNCE_PER_KEY
+    CHECK_EQUAL(changed, KEY_A);
+#else
+    CHECK_EQUAL(changed, 0);
+#endif
+}
+
+// A tap over before the first sample still goes out, once latched
+static void test_latch(void)
+{
+    debounce_t deb;
+
+    debounce_init(&deb);
+    debounce_profile(&deb, DEBOUNCE_DEFER, 5, 5);
+    debounce_latch(&deb, KEY_A);
+    CHECK(debounce_pending(&deb));
+
+    CHECK_EQUAL(run(&deb, 0, 5), 0);
+    CHECK_EQUAL(debounce_tick(&deb, 0), KEY_A);
+    CHECK_EQUAL(deb.latched, 0);
+    CHECK_EQUAL(run(&deb, 0, 5), 0);
+    CHECK_EQUAL(debounce_tick(&deb, 0), KEY_A);
+    CHECK_EQUAL(deb.keys, 0);
+}
+
+// Idle once ACTIVITY samples with nothing pressed have gone by
+static void test_idle(void)
+{
+    debounce_t deb;
+    uint32_t ticks = 0;
+
+    debounce_init(&deb);
+    CHECK(!debounce_idle(&deb, KEY_A));
+    while (!debounce_idle(&deb, 0))
+    {
+        ticks++;
+    }
+    CHECK_EQUAL(ticks, ACTIVITY);
+}
+
+int main(void)
+{
+    test_defer();
+    test_bounce();
+    test_asym();
+    test_eager();
+    test_profile();
+    test_independent();
+    test_latch();
+    test_idle();
+#if DEBOUNCE_PER_KEY
+    return check_done("test_debounce");
+#else
+    return check_done("test_debounce_matrix");
+#endif
+}
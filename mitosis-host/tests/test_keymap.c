@@ -0,0 +1,216 @@
+#include <string.h>
+#include "check.h"
+#include "keymap.h"
+
+// The keymap of keymap.def resolved into HID reports, key by key, by row and
+// column of QMK's matrix
+
+#define LOWER_ROW   3
+#define LOWER_COL   5
+#define RAISE_ROW   4
+#define RAISE_COL   6
+#define NAV_ROW     4       ///< TG(NAV) on LOWER, and on NAV itself
+#define NAV_COL     6
+#define LSFT_ROW    4
+#define LSFT_COL    2
+
+static keymap_t keymap;
+
+// True if the report holds the keycode
+static bool reported(uint8_t keycode)
+{
+    for (uint8_t i = 0; i < HID_REPORT_KEYS; i++)
+    {
+        if (keymap.report.keys[i] == keycode)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t keys_reported(void)
+{
+    uint32_t count = 0;
+
+    for (uint8_t i = 0; i < HID_REPORT_KEYS; i++)
+    {
+        count += keymap.report.keys[i] != KC_NO;
+    }
+    return count;
+}
+
+static void tap(uint8_t row, uint8_t col)
+{
+    keymap_event(&keymap, row, col, true);
+    keymap_event(&keymap, row, col, false);
+}
+
+// A key held on a layer is released as what it was pressed as, whichever
+// layers are in effect by then
+static void test_momentary(void)
+{
+    keymap_init(&keymap);
+    keymap_event(&keymap, 0, 0, true);
+    CHECK(reported(KC_Q));
+    keymap_event(&keymap, 0, 0, false);
+    CHECK(!reported(KC_Q));
+
+    keymap_event(&keymap, LOWER_ROW, LOWER_COL, true);
+    CHECK(keymap.layers & (1 << LAYER_LOWER));
+    keymap_event(&keymap, 0, 0, true);
+    CHECK(reported(KC_1));
+    CHECK(!reported(KC_Q));
+
+    keymap_event(&keymap, LOWER_ROW, LOWER_COL, false);
+    CHECK(!(keymap.layers & (1 << LAYER_LOWER)));
+    CHECK(reported(KC_1));
+    keymap_event(&keymap, 0, 0, false);
+    CHECK_EQUAL(keys_reported(), 0);
+
+    // transparent keys fall through to the base layer
+    keymap_event(&keymap, RAISE_ROW, RAISE_COL, true);
+    keymap_event(&keymap, 3, 1, true);
+    CHECK(reported(KC_ESC));
+    keymap_event(&keymap, 3, 1, false);
+    keymap_event(&keymap, RAISE_ROW, RAISE_COL, false);
+    CHECK_EQUAL(keymap.layers, 1 << LAYER_BASE);
+}
+
+// TG turns its layer on with one tap and off with the next, on the layer
+// itself, and outlasts the layer it was tapped from
+static void test_toggle(void)
+{
+    keymap_init(&keymap);
+    keymap_event(&keymap, LOWER_ROW, LOWER_COL, true);
+    tap(NAV_ROW, NAV_COL);
+    keymap_event(&keymap, LOWER_ROW, LOWER_COL, false);
+    CHECK_EQUAL(keymap.layers, 1 << LAYER_BASE | 1 << LAYER_NAV);
+
+    tap(0, 7);
+    CHECK_EQUAL(keys_reported(), 0);
+    keymap_event(&keymap, 0, 7, true);
+    CHECK(reported(KC_UP));
+    keymap_event(&keymap, 0, 7, false);
+
+    // and the left half is still the base layer beneath
+    keymap_event(&keymap, 0, 0, true);
+    CHECK(reported(KC_Q));
+    keymap_event(&keymap, 0, 0, false);
+
+    tap(NAV_ROW, NAV_COL);
+    CHECK_EQUAL(keymap.layers, 1 << LAYER_BASE);
+    keymap_event(&keymap, 0, 7, true);
+    CHECK(reported(KC_I));
+}
+
+// Keys with modifiers add them to the report only while they are held, and
+// leave a shift held by its own key alone
+static void test_weak_mods(void)
+{
+    keymap_init(&keymap);
+    keymap_event(&keymap, LOWER_ROW, LOWER_COL, true);
+    keymap_event(&keymap, 1, 0, true);
+    CHECK(reported(KC_1));
+    CHECK_EQUAL(keymap.report.modifiers, MODIFIER_BIT(KC_LSFT));
+    CHECK_EQUAL(keymap.held.modifiers, 0);
+
+    keymap_event(&keymap, 1, 0, false);
+    CHECK_EQUAL(keymap.report.modifiers, 0);
+    CHECK_EQUAL(keys_reported(), 0);
+
+    keymap_event(&keymap, LSFT_ROW, LSFT_COL, true);
+    keymap_event(&keymap, 1, 1, true);
+    keymap_event(&keymap, 1, 1, false);
+    CHECK_EQUAL(keymap.report.modifiers, MODIFIER_BIT(KC_LSFT));
+    keymap_event(&keymap, LSFT_ROW, LSFT_COL, false);
+    CHECK_EQUAL(keymap.report.modifiers, 0);
+}
+
+// Two keys pressed as the same keycode hold it until both are released
+static void test_shared_keycode(void)
+{
+    keymap_init(&keymap);
+    keymap_event(&keymap, 4, 4, true);
+    keymap_event(&keymap, 4, 5, true);
+    CHECK(reported(KC_SPC));
+    CHECK_EQUAL(keys_reported(), 1);
+
+    keymap_event(&keymap, 4, 4, false);
+    CHECK(reported(KC_SPC));
+    keymap_event(&keymap, 4, 5, false);
+    CHECK(!reported(KC_SPC));
+}
+
+// Past six keys, held keys wait for a slot, and take the first to free up
+// while still held, ahead of keys pressed later
+static void test_rollover(void)
+{
+    keymap_init(&keymap);
+    for (uint8_t col = 0; col < 7; col++)
+    {
+        keymap_event(&keymap, 0, col, true);
+    }
+    CHECK_EQUAL(keys_reported(), HID_REPORT_KEYS);
+    CHECK_EQUAL(keymap.rollover, 1);
+    CHECK(!reported(KC_U));
+
+    keymap_event(&keymap, 0, 7, true);
+    CHECK_EQUAL(keymap.rollover, 2);
+
+    keymap_event(&keymap, 0, 0, false);
+    CHECK(reported(KC_U));
+    CHECK(!reported(KC_I));
+    CHECK(!reported(KC_Q));
+    CHECK_EQUAL(keymap.rollover, 1);
+
+    keymap_event(&keymap, 0, 1, false);
+    CHECK(reported(KC_I));
+    CHECK_EQUAL(keys_reported(), HID_REPORT_KEYS);
+    CHECK_EQUAL(keymap.rollover, 0);
+
+    // released while waiting, a key is never reported
+    keymap_init(&keymap);
+    for (uint8_t col = 0; col < 7; col++)
+    {
+        keymap_event(&keymap, 0, col, true);
+    }
+    keymap_event(&keymap, 0, 6, false);
+    keymap_event(&keymap, 0, 0, false);
+    CHECK(!reported(KC_U));
+    CHECK_EQUAL(keys_reported(), HID_REPORT_KEYS - 1);
+    CHECK_EQUAL(keymap.rollover, 0);
+}
+
+// A frame resolves every key that moved, and says if the report changed
+static void test_frame(void)
+{
+    uint8_t old_buffer[2 * MATRIX_ROWS] = {0};
+    uint8_t data_buffer[2 * MATRIX_ROWS] = {0};
+
+    keymap_init(&keymap);
+    data_buffer[0] = 1 << 0;
+    data_buffer[1] = 1 << 1;
+    CHECK(keymap_frame(&keymap, old_buffer, data_buffer));
+    CHECK(reported(KC_Q));
+    CHECK(reported(KC_U));
+
+    memcpy(old_buffer, data_buffer, sizeof(old_buffer));
+    CHECK(!keymap_frame(&keymap, old_buffer, data_buffer));
+
+    data_buffer[1] = 0;
+    CHECK(keymap_frame(&keymap, old_buffer, data_buffer));
+    CHECK(!reported(KC_U));
+    CHECK(reported(KC_Q));
+}
+
+int main(void)
+{
+    test_momentary();
+    test_toggle();
+    test_weak_mods();
+    test_shared_keycode();
+    test_rollover();
+    test_frame();
+    return check_done("test_keymap");
+}
@@ -0,0 +1,198 @@
+#include <string.h>
+#include "check.h"
+#include "keystates.h"
+#include "packet.h"
+#include "mitosis_matrix.h"
+
+// The halves' payloads, as packet.c builds them, decoded by the receiver
+
+#define S01     WIRE_BIT(0)
+#define S07     WIRE_BIT(6)
+#define S23     WIRE_BIT(22)
+
+static uint8_t payload[PAYLOAD_MAX_LENGTH];
+
+static uint32_t keys(const half_t *half)
+{
+    return WIRE_WORD(half->keys);
+}
+
+// Events in order are applied, and unpack into the half's rows
+static void test_events(void)
+{
+    uint8_t data_buffer[2 * MATRIX_ROWS] = {0};
+    uint8_t sequence = 0;
+    half_t half;
+
+    keystates_init(&half, SIDE_RIGHT);
+    keystates_decode(&half, payload, packet_events(payload, S01 | S07, S01 | S07, &sequence), 100);
+    CHECK_EQUAL(keys(&half), S01 | S07);
+    CHECK_EQUAL(half.sequence, 2);
+    CHECK(!half.stamped);
+    CHECK_EQUAL(half.stamp, 100);
+
+    keystates_unpack(&half, data_buffer);
+    CHECK_EQUAL(data_buffer[1], (RIGHT_MATRIX_BIT(0) | RIGHT_MATRIX_BIT(6)) & 0x1F);
+    CHECK_EQUAL(data_buffer[3], (RIGHT_MATRIX_BIT(6) >> MATRIX_COLS) & 0x1F);
+    CHECK_EQUAL(data_buffer[0], 0);
+
+    keystates_decode(&half, payload, packet_events(payload, S07, S01, &sequence), 200);
+    CHECK_EQUAL(keys(&half), S07);
+    CHECK_EQUAL(half.lost, 0);
+    CHECK_EQUAL(half.received, 2);
+}
+
+// A gap in the sequence is counted, and the bitmap taken as it is
+static void test_gap(void)
+{
+    uint8_t sequence = 0;
+    uint8_t stale[PAYLOAD_MAX_LENGTH];
+    uint32_t stale_length;
+    half_t half;
+
+    keystates_init(&half, SIDE_LEFT);
+    keystates_decode(&half, payload, packet_events(payload, S01, S01, &sequence), 0);
+    stale_length = packet_events(stale, S01 | S07, S07, &sequence);
+    packet_events(payload, S01 | S07 | S23, S23, &sequence);
+    keystates_decode(&half, payload, packet_events(payload, S07 | S23, S01, &sequence), 0);
+    CHECK_EQUAL(half.lost, 2);
+    CHECK_EQUAL(keys(&half), S07 | S23);
+
+    // and a packet from before is stale, leaving the keys alone
+    keystates_decode(&half, stale, stale_length, 0);
+    CHECK_EQUAL(half.stale, 1);
+    CHECK_EQUAL(keys(&half), S07 | S23);
+}
+
+// Events missed before a keepalive are counted once, however many keepalives
+// follow, and the next events bring the keys back in sync
+static void test_unchanged_gap(void)
+{
+    uint8_t sequence = 0;
+    half_t half;
+
+    keystates_init(&half, SIDE_LEFT);
+    keystates_decode(&half, payload, packet_events(payload, S01, S01, &sequence), 0);
+    packet_events(payload, S01 | S07, S07, &sequence);
+
+    keystates_decode(&half, payload, packet_unchanged(payload, sequence, 125), 0);
+    keystates_decode(&half, payload, packet_unchanged(payload, sequence, 250), 0);
+    keystates_decode(&half, payload, packet_unchanged(payload, sequence, 500), 0);
+    CHECK_EQUAL(half.lost, 1);
+    CHECK_EQUAL(keys(&half), S01);
+    CHECK_EQUAL(half.timeout, MS_TO_TICKS(INACTIVE));
+
+    keystates_decode(&half, payload, packet_state(payload, S01 | S07, sequence), 0);
+    CHECK_EQUAL(half.lost, 1);
+    CHECK_EQUAL(keys(&half), S01 | S07);
+    CHECK(half.synced);
+}
+
+// Keepalives set how long the keys are held for without another, and the
+// keys are released and the half unlinked once that has gone by
+static void test_inactivity(void)
+{
+    uint8_t sequence = 0;
+    uint32_t deadline;
+    half_t half;
+
+    keystates_init(&half, SIDE_LEFT);
+    CHECK(!keystates_linked(&half));
+    CHECK(!keystates_deadline(&half, &deadline));
+
+    keystates_heard(&half, 1000);
+    keystates_decode(&half, payload, packet_events(payload, S01, S01, &sequence), 1000);
+    CHECK(keystates_linked(&half));
+    CHECK(keystates_deadline(&half, &deadline));
+    CHECK_EQUAL(deadline, 1000 + MS_TO_TICKS(INACTIVE) + 1);
+
+    keystates_decode(&half, payload, packet_unchanged(payload, sequence, 2000), 1000);
+    CHECK_EQUAL(half.timeout, MS_TO_TICKS(2000 * KEEPALIVE_MISSES));
+
+    CHECK(!keystates_idle(&half, 1000 + MS_TO_TICKS(2000 * KEEPALIVE_MISSES)));
+    CHECK(keystates_linked(&half));
+    CHECK(keystates_idle(&half, 1001 + MS_TO_TICKS(2000 * KEEPALIVE_MISSES)));
+    CHECK(!keystates_linked(&half));
+    CHECK_EQUAL(keys(&half), 0);
+    CHECK(!keystates_deadline(&half, &deadline));
+
+    // and stays unlinked, however long after, until heard from again
+    CHECK(!keystates_idle(&half, 1000 + TIMEBASE_MASK / 2 + 1));
+    CHECK(!keystates_linked(&half));
+
+    // the timebase wraps
+    keystates_heard(&half, TIMEBASE_MASK - 10);
+    keystates_decode(&half, payload, packet_events(payload, S01, S01, &sequence), half.seen);
+    CHECK(!keystates_idle(&half, 100));
+    CHECK(keystates_idle(&half, MS_TO_TICKS(INACTIVE)));
+    CHECK(!keystates_linked(&half));
+
+    // a half with nothing held is unlinked all the same, with no keys to release
+    keystates_heard(&half, 5000);
+    CHECK(keystates_deadline(&half, &deadline));
+    CHECK(!keystates_idle(&half, 5001 + MS_TO_TICKS(INACTIVE)));
+    CHECK(!keystates_linked(&half));
+}
+
+// Stamps are taken unless they are from after the payload arrived
+static void test_stamp(void)
+{
+    uint8_t sequence = 0;
+    half_t half;
+
+    keystates_init(&half, SIDE_LEFT);
+    keystates_decode(&half, payload, packet_stamped(payload, S01, S01, &sequence, 900), 1000);
+    CHECK(half.stamped);
+    CHECK_EQUAL(half.stamp, 900);
+    CHECK_EQUAL(keys(&half), S01);
+
+    keystates_decode(&half, payload, packet_stamped(payload, 0, S01, &sequence, 1100), 1000);
+    CHECK(!half.stamped);
+    CHECK_EQUAL(half.stamp, 1000);
+    CHECK_EQUAL(keys(&half), 0);
+}
+
+// The original firmware's bare bitmap, and payloads of an unknown version or
+// type
+static void test_formats(void)
+{
+    uint8_t legacy[LEGACY_PAYLOAD_LENGTH] = { 0x80, 0, 0x02 };
+    uint8_t sequence = 0;
+    uint32_t length;
+    half_t half;
+
+    keystates_init(&half, SIDE_LEFT);
+    keystates_decode(&half, legacy, sizeof(legacy), 0);
+    CHECK_EQUAL(keys(&half), S01 | S23);
+
+    length = packet_events(payload, S07, S07, &sequence);
+    payload[PAYLOAD_HEADER] = (PROTOCOL_VERSION + 1) << 4 | PACKET_EVENTS;
+    keystates_decode(&half, payload, length, 0);
+    CHECK_EQUAL(half.rejected, 1);
+    CHECK_EQUAL(keys(&half), S01 | S23);
+
+    // packets that aren't keystates, whatever their length
+    length = packet_events(payload, S07, S07, &sequence);
+    for (uint8_t type = PACKET_PAIR; type < 16; type++)
+    {
+        if (type == PACKET_STAMPED)
+        {
+            continue;
+        }
+        payload[PAYLOAD_HEADER] = PACKET_HEADER(type);
+        keystates_decode(&half, payload, length, 0);
+    }
+    CHECK_EQUAL(half.rejected, 13);
+    CHECK_EQUAL(keys(&half), S01 | S23);
+}
+
+int main(void)
+{
+    test_events();
+    test_gap();
+    test_unchanged_gap();
+    test_inactivity();
+    test_stamp();
+    test_formats();
+    return check_done("test_keystates");
+}
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include "check.h"
+#include "board.h"
+#include "powerstats.h"
+#include "mitosis_protocol.h"
+#include "mitosis.h"
+
+// Both halves and the receiver, running their firmware against each other in
+// the simulator, with QMK reading the frames
+
+static board_t board;
+
+static void start(bool framed)
+{
+    sim_init();
+    board_init(&board, 0x1000, true);
+    board_power_on(&board);
+    sim_run(SIM_S);
+    board_stream(&board, framed);
+    sim_run(10 * SIM_MS);
+}
+
+// The same, with halves sampling on edges
+static void start_edge(void)
+{
+    sim_init();
+    board_init_halves(&board, 0x1000, true, &keyboard_left_edge_firmware,
+                      &keyboard_right_edge_firmware);
+    board_power_on(&board);
+    sim_run(SIM_S);
+    board_stream(&board, true);
+    sim_run(10 * SIM_MS);
+}
+
+// Every tap on either half gets through, once each, in good time
+static void test_typing(bool framed)
+{
+    uint64_t time;
+
+    start(framed);
+    time = sim_now();
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        board_tap(&board, i % 2, sim_random() % BOARD_KEYS, time, 40 * SIM_MS, 2 * SIM_MS);
+        time += 60 * SIM_MS + sim_random() % (60 * SIM_MS);
+    }
+    sim_run_until(time + SIM_S);
+
+    CHECK_EQUAL(board.latencies, 400);
+    CHECK_EQUAL(board_dropped(&board), 0);
+    CHECK_EQUAL(board.phantoms, 0);
+    CHECK_EQUAL(board.bad_frames, 0);
+    CHECK(board_latency(&board, 100) < 20 * SIM_MS);
+    board_report(&board, framed ? "framed" : "legacy");
+}
+
+// Polled by QMK every scan, as it always has been, rather than streaming
+static void test_polled(void)
+{
+    uint64_t time;
+
+    sim_init();
+    board_init(&board, 0x1000, true);
+    board_power_on(&board);
+    sim_run(SIM_S);
+    board_poll(&board, BOARD_QMK_SCAN);
+    sim_run(10 * SIM_MS);
+
+    time = sim_now();
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        board_tap(&board, i % 2, sim_random() % BOARD_KEYS, time, 40 * SIM_MS, 2 * SIM_MS);
+        time += 60 * SIM_MS + sim_random() % (60 * SIM_MS);
+    }
+    sim_run_until(time + SIM_S);
+
+    CHECK_EQUAL(board.latencies, 400);
+    CHECK_EQUAL(board_dropped(&board), 0);
+    CHECK_EQUAL(board.phantoms, 0);
+    CHECK_EQUAL(board.bad_frames, 0);
+    CHECK(board_latency(&board, 100) < 20 * SIM_MS);
+    board_report(&board, "polled");
+}
+
+// A key held for a long time is kept alive, and released once the half has
+// missed its keepalives
+static void test_held(void)
+{
+    start(true);
+    board_key(&board, BOARD_LEFT, 4, true, sim_now(), 0);
+    sim_run(10 * SIM_S);
+    CHECK(board_held(&board, BOARD_LEFT, 4));
+    CHECK(board.status & FRAMED_STATUS_LEFT);
+    CHECK_EQUAL(board.phantoms, 0);
+
+    sim_power_off(board.half[BOARD_LEFT]);
+    sim_run(10 * SIM_S);
+    CHECK(!board_held(&board, BOARD_LEFT, 4));
+    CHECK(!(board.status & FRAMED_STATUS_LEFT));
+
+    // with the other half still there
+    board_tap(&board, BOARD_RIGHT, 4, sim_now(), 40 * SIM_MS, 0);
+    sim_run(100 * SIM_MS);
+    CHECK(board.status & FRAMED_STATUS_RIGHT);
+    CHECK(!(board.status & FRAMED_STATUS_LEFT));
+}
+
+// A release that ran out of attempts gets through with the next full
+// keystates, rather than waiting for the receiver to time the half out
+static void test_resync(void)
+{
+    start(true);
+    board_key(&board, BOARD_RIGHT, 7, true, sim_now(), 0);
+    sim_run(100 * SIM_MS);
+    CHECK(board_held(&board, BOARD_RIGHT, 7));
+
+    sim_config.loss = 1;
+    board_key(&board, BOARD_RIGHT, 7, false, sim_now(), 0);
+    sim_run(200 * SIM_MS);
+    sim_config.loss = 0;
+    CHECK(board_held(&board, BOARD_RIGHT, 7));
+    CHECK(sim_counts(board.half[BOARD_RIGHT])->failed > 0);
+
+    sim_run(300 * SIM_MS);
+    CHECK(!board_held(&board, BOARD_RIGHT, 7));
+    CHECK(board.status & FRAMED_STATUS_RIGHT);
+    CHECK_EQUAL(board.phantoms, 0);
+}
+
+// Lost packets and ACKs are retried without losing or repeating keys
+static void test_loss(void)
+{
+    sim_config.loss = 0.2;
+    start(true);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        board_tap(&board, i % 2, i % BOARD_KEYS, sim_now() + i * 100 * SIM_MS, 50 * SIM_MS, 0);
+    }
+    sim_run(11 * SIM_S);
+    sim_config.loss = 0;
+
+    CHECK_EQUAL(board_dropped(&board), 0);
+    CHECK_EQUAL(board.phantoms, 0);
+    CHECK(sim_counts(board.half[BOARD_LEFT])->attempts > sim_counts(board.half[BOARD_LEFT])->packets);
+    board_report(&board, "20% loss");
+}
+
+// Power stats of the left half, as the receiver reports them to QMK
+static void power_frame(void *ctx, const uint8_t *raw, uint32_t length)
+{
+    if (FRAMED_TYPE(raw[0]) == FRAMED_POWER_STATS && raw[FRAMED_BODY] == BOARD_PIPE(BOARD_LEFT))
+    {
+        power_stats_unpack(ctx, &raw[FRAMED_BODY + 1]);
+    }
+}
+
+// Halves idle for SYSTEM_OFF_DELAY power down to System OFF, and the next
+// press wakes them with a reset and still gets through, counted in their
+// power stats
+static void test_system_off(void)
+{
+    power_stats_t power = {0};
+    uint8_t request = 'E';
+
+    start(true);
+    board_tap(&board, BOARD_LEFT, 4, sim_now(), 40 * SIM_MS, 2 * SIM_MS);
+    sim_run(59 * SIM_S);
+    CHECK(!sim_system_is_off(board.half[BOARD_LEFT]));
+    sim_run(2 * SIM_S);
+    CHECK(sim_system_is_off(board.half[BOARD_LEFT]));
+    CHECK(sim_system_is_off(board.half[BOARD_RIGHT]));
+    CHECK_EQUAL(sim_counts(board.half[BOARD_LEFT])->offs, 1);
+    CHECK_EQUAL(sim_counts(board.half[BOARD_RIGHT])->offs, 1);
+
+    // woken by the press, sent before the crystal has started, and released
+    // once the debounce has the crystal to tick on
+    board_key(&board, BOARD_LEFT, 5, true, sim_now(), 2 * SIM_MS);
+    sim_run(100 * SIM_MS);
+    CHECK(!sim_system_is_off(board.half[BOARD_LEFT]));
+    CHECK(sim_system_is_off(board.half[BOARD_RIGHT]));
+    CHECK_EQUAL(sim_counts(board.half[BOARD_LEFT])->resets, 2);
+    CHECK_EQUAL(board.latencies, 3);
+    CHECK(board_latency(&board, 100) < 20 * SIM_MS);
+
+    board_key(&board, BOARD_LEFT, 5, false, sim_now(), 2 * SIM_MS);
+    sim_run(SIM_S);
+    CHECK_EQUAL(board.latencies, 4);
+    CHECK_EQUAL(board_dropped(&board), 0);
+    CHECK_EQUAL(board.phantoms, 0);
+
+    // a key held long enough for the half to report its counts
+    board_key(&board, BOARD_LEFT, 6, true, sim_now(), 0);
+    sim_run(11 * SIM_S);
+    board_key(&board, BOARD_LEFT, 6, false, sim_now(), 0);
+    sim_run(100 * SIM_MS);
+    board.on_frame = power_frame;
+    board.ctx = &power;
+    sim_uart_send(board.receiver, &request, 1);
+    sim_run(10 * SIM_MS);
+    board.on_frame = NULL;
+
+    CHECK_EQUAL(power.offs, 1);
+    CHECK(power.residency[POWER_IDLE] > 59 * power.hz);
+    CHECK(power.residency[POWER_SAMPLING] > 10 * power.hz);
+    CHECK_EQUAL(power.wakes, 3);
+    printf("%-28s idle %.1fs  held %.1fs  sampling %.2fs  offs %u  wakes %u\n", "system off",
+           (double)power.residency[POWER_IDLE] / power.hz,
+           (double)power.residency[POWER_HELD] / power.hz,
+           (double)power.residency[POWER_SAMPLING] / power.hz, power.offs, power.wakes);
+}
+
+// Sampling on edges, a tap from idle over before the debounce window is
+// latched and gets through, as does typing at speed
+static void test_edge_tap(void)
+{
+    uint64_t time;
+
+    start_edge();
+    time = sim_now();
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        board_tap(&board, i % 2, i % BOARD_KEYS, time, 2 * SIM_MS, 0);
+        time += 600 * SIM_MS;
+    }
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        board_tap(&board, i % 2, sim_random() % BOARD_KEYS, time, 40 * SIM_MS, 2 * SIM_MS);
+        time += 60 * SIM_MS + sim_random() % (60 * SIM_MS);
+    }
+    sim_run_until(time + SIM_S);
+
+    CHECK_EQUAL(board.latencies, 440);
+    CHECK_EQUAL(board_dropped(&board), 0);
+    CHECK_EQUAL(board.phantoms, 0);
+    CHECK(board_latency(&board, 100) < 20 * SIM_MS);
+    board_report(&board, "sampling on edges");
+}
+
+// Sampling on edges, a switch chattering once after its release has been
+// sent and the tick has stopped isn't latched as a press
+static void test_edge_chatter(void)
+{
+    uint64_t time;
+
+    start_edge();
+    time = sim_now();
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        board_tap(&board, BOARD_LEFT, 4, time, 50 * SIM_MS, 0);
+        sim_switch(board.half[BOARD_LEFT], L_S05, true, time + 80 * SIM_MS);
+        sim_switch(board.half[BOARD_LEFT], L_S05, false, time + 81 * SIM_MS);
+        time += 600 * SIM_MS;
+    }
+    sim_run_until(time + SIM_S);
+
+    CHECK_EQUAL(board.latencies, 40);
+    CHECK_EQUAL(board_dropped(&board), 0);
+    CHECK_EQUAL(board.phantoms, 0);
+}
+
+// Tap lengths for the sweep, from a brush of the key to a quick tap
+static const uint64_t tap_holds[] = {
+    500 * SIM_US, 1 * SIM_MS, 2 * SIM_MS, 3 * SIM_MS, 5 * SIM_MS, 8 * SIM_MS, 12 * SIM_MS, 20 * SIM_MS,
+};
+#define TAP_HOLDS (sizeof(tap_holds) / sizeof(tap_holds[0]))
+
+// Every tap from idle, however short, is sent as one press and one release,
+// polled or sampling on edges, with each debounce algorithm the receiver can
+// set. Polled, a tap over before the next sample is only seen through the
+// latch of the waking edge.
+static void test_tap_sweep(void)
+{
+    static const char *modes[CONTROL_DEBOUNCE_MODES] = {"defer", "asym", "eager"};
+    uint8_t setting[4] = {'B', 0, 5, 5};
+    uint32_t latencies;
+    uint64_t time;
+
+    for (uint32_t edge = 0; edge < 2; edge++)
+    {
+        for (uint8_t mode = 0; mode < CONTROL_DEBOUNCE_MODES; mode++)
+        {
+            if (edge)
+            {
+                start_edge();
+            }
+            else
+            {
+                start(true);
+            }
+            setting[1] = mode;
+            sim_uart_send(board.receiver, setting, sizeof(setting));
+            sim_run(10 * SIM_MS);
+
+            // the halves take the setting from the ACK to their next packet
+            board_tap(&board, BOARD_LEFT, 0, sim_now(), 40 * SIM_MS, 0);
+            board_tap(&board, BOARD_RIGHT, 0, sim_now(), 40 * SIM_MS, 0);
+            sim_run(SIM_S);
+            latencies = board.latencies;
+
+            // far enough apart for the edge build to have gone idle
+            time = sim_now();
+            for (uint32_t i = 0; i < 2 * TAP_HOLDS; i++)
+            {
+                board_tap(&board, i % 2, 1 + i % (BOARD_KEYS - 1), time, tap_holds[i / 2], 0);
+                time += 700 * SIM_MS;
+            }
+            sim_run_until(time + SIM_S);
+
+            if (board.latencies - latencies != 4 * TAP_HOLDS)
+            {
+                fprintf(stderr, "tap sweep, %s, %s: %u of %u\n", edge ? "edges" : "polled",
+                        modes[mode], board.latencies - latencies, (uint32_t)(4 * TAP_HOLDS));
+            }
+            CHECK_EQUAL(board.latencies - latencies, 4 * TAP_HOLDS);
+            CHECK_EQUAL(board_dropped(&board), 0);
+            CHECK_EQUAL(board.phantoms, 0);
+        }
+    }
+}
+
+int main(void)
+{
+    test_typing(true);
+    test_typing(false);
+    test_polled();
+    test_held();
+    test_resync();
+    test_loss();
+    test_system_off();
+    test_edge_tap();
+    test_edge_chatter();
+    test_tap_sweep();
+    return check_done("test_link");
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include "check.h"
+#include "board.h"
+#include "mitosis.h"
+
+// Halves pairing with their receiver and being given pipes, failing to, and
+// two boards typing in the same room, on addresses of their own or the
+// shared ones
+
+static board_t board, other;
+
+static bool paired(sim_chip_t *half)
+{
+    return sim_flash(half)[0] == PAIRING_MAGIC;
+}
+
+// Pipes of a stored pairing, the half's own or those the receiver gave out
+static uint32_t pipes(sim_chip_t *chip)
+{
+    return ((const pairing_t *)sim_flash(chip))->pipes;
+}
+
+// Every tap on either half gets through, once each
+static void check_typing(board_t *board)
+{
+    uint32_t latencies = board->latencies, phantoms = board->phantoms;
+    uint64_t time = sim_now();
+
+    for (uint32_t i = 0; i < 40; i++)
+    {
+        board_tap(board, i % 2, i % BOARD_KEYS, time, 40 * SIM_MS, 0);
+        time += 100 * SIM_MS;
+    }
+    sim_run_until(time + SIM_S);
+
+    CHECK_EQUAL(board->latencies - latencies, 80);
+    CHECK_EQUAL(board_dropped(board), 0);
+    CHECK_EQUAL(board->phantoms, phantoms);
+}
+
+// Out of the box, both halves pair within the receiver's first window, are
+// given the first pipes, and are heard on its own addresses once it closes
+static void test_first_boot(void)
+{
+    sim_init();
+    board_init(&board, 0x1000, false);
+    board_power_on(&board);
+    sim_run(5 * SIM_S);
+    CHECK(paired(board.half[BOARD_LEFT]));
+    CHECK(paired(board.half[BOARD_RIGHT]));
+    CHECK_EQUAL(pipes(board.half[BOARD_LEFT]), 1 << BOARD_PIPE(BOARD_LEFT));
+    CHECK_EQUAL(pipes(board.half[BOARD_RIGHT]), 1 << BOARD_PIPE(BOARD_RIGHT));
+    CHECK(!sim_pin_out(board.half[BOARD_LEFT], L_LED));
+    CHECK(!sim_pin_out(board.half[BOARD_RIGHT], R_LED));
+
+    sim_run(30 * SIM_S);
+    CHECK_EQUAL(pipes(board.receiver), 1 << BOARD_PIPE(BOARD_LEFT) | 1 << BOARD_PIPE(BOARD_RIGHT));
+    board_stream(&board, true);
+    sim_run(10 * SIM_MS);
+    check_typing(&board);
+}
+
+// A half that never paired and gave up lights its LED, and asks again from
+// the next key pressed
+static void test_retry(void)
+{
+    uint8_t pair = 'P';
+
+    // the halves come up after the receiver's first window has closed
+    sim_init();
+    board_init(&board, 0x1000, false);
+    sim_power_on(board.receiver);
+    sim_run(31 * SIM_S);
+    board_stream(&board, true);
+    sim_power_on(board.half[BOARD_LEFT]);
+    sim_power_on(board.half[BOARD_RIGHT]);
+    sim_run(29 * SIM_S);
+    CHECK(!sim_pin_out(board.half[BOARD_LEFT], L_LED));
+
+    sim_run(2 * SIM_S);
+    CHECK(!paired(board.half[BOARD_LEFT]));
+    CHECK(!paired(board.half[BOARD_RIGHT]));
+    CHECK(sim_pin_out(board.half[BOARD_LEFT], L_LED));
+    CHECK(sim_pin_out(board.half[BOARD_RIGHT], R_LED));
+
+    // still lit, and still unpaired, whatever time goes by
+    sim_run(60 * SIM_S);
+    CHECK(sim_pin_out(board.half[BOARD_LEFT], L_LED));
+    CHECK(!paired(board.half[BOARD_LEFT]));
+
+    // the window open, a key on each half starts another session
+    sim_uart_send(board.receiver, &pair, 1);
+    sim_run(10 * SIM_MS);
+    sim_switch(board.half[BOARD_LEFT], L_S05, true, sim_now());
+    sim_switch(board.half[BOARD_LEFT], L_S05, false, sim_now() + 50 * SIM_MS);
+    sim_switch(board.half[BOARD_RIGHT], R_S05, true, sim_now());
+    sim_switch(board.half[BOARD_RIGHT], R_S05, false, sim_now() + 50 * SIM_MS);
+    sim_run(2 * SIM_S);
+    CHECK(paired(board.half[BOARD_LEFT]));
+    CHECK(paired(board.half[BOARD_RIGHT]));
+    CHECK(!sim_pin_out(board.half[BOARD_LEFT], L_LED));
+    CHECK(!sim_pin_out(board.half[BOARD_RIGHT], R_LED));
+
+    // the keys went to the pairing pipe, which takes nothing else in. QMK
+    // starts the stream over, past the reply to P.
+    sim_run(30 * SIM_S);
+    board_stream(&board, true);
+    sim_run(10 * SIM_MS);
+    check_typing(&board);
+}
+
+// A second board pairing with the receiver is given the next free pipes, and
+// a half pairing again, with its pairing key held at power on, is given its
+// own pipe back. The first board types on all through the window.
+static void test_second_board(void)
+{
+    uint8_t pair = 'P';
+    sim_chip_t *left, *right;
+
+    sim_init();
+    board_init(&board, 0x1000, true);
+    left = sim_chip(&keyboard_left_firmware, 0x3001);
+    right = sim_chip(&keyboard_right_firmware, 0x3002);
+    board_power_on(&board);
+    sim_run(SIM_S);
+
+    sim_uart_send(board.receiver, &pair, 1);
+    sim_run(10 * SIM_MS);
+    sim_power_on(left);
+    sim_power_on(right);
+    sim_power_off(board.half[BOARD_LEFT]);
+    sim_switch(board.half[BOARD_LEFT], L_S01, true, sim_now());
+    sim_power_on(board.half[BOARD_LEFT]);
+    sim_switch(board.half[BOARD_LEFT], L_S01, false, sim_now() + 100 * SIM_MS);
+    sim_run(2 * SIM_S);
+    CHECK_EQUAL(pipes(left), 1 << 3);
+    CHECK_EQUAL(pipes(right), 1 << 4);
+    CHECK_EQUAL(pipes(board.half[BOARD_LEFT]), 1 << BOARD_PIPE(BOARD_LEFT));
+
+    board_stream(&board, true);
+    sim_run(10 * SIM_MS);
+    check_typing(&board);
+
+    // stored once the window closes
+    sim_run(30 * SIM_S);
+    CHECK_EQUAL(pipes(board.receiver), 0x1E);
+    check_typing(&board);
+}
+
+// Two boards typing at once. On the shared addresses, both receivers ACK
+// every packet, so the ACKs collide and are retried, and each board types on
+// the other. Paired, neither hears the other. Without capture, colliding ACKs
+// are all lost and the shared boards would get next to nothing through, so
+// half the time the device makes out one of them, as the nearer receiver's
+// often would. That fraction is a guess, and only the comparison counts.
+static uint32_t crowd(bool shared, uint32_t *packets_out)
+{
+    uint32_t attempts = 0, packets = 0;
+    uint64_t time;
+
+    sim_config.capture = 0.5;
+    sim_init();
+    board_init(&board, 0x1000, true);
+    board_init(&other, 0x2000, true);
+    if (shared)
+    {
+        board_share(&board);
+        board_share(&other);
+    }
+    board_power_on(&board);
+    board_power_on(&other);
+    sim_run(SIM_S);
+    board_stream(&board, true);
+    board_stream(&other, true);
+    sim_run(10 * SIM_MS);
+
+    for (uint32_t side = 0; side < 2; side++)
+    {
+        attempts -= sim_counts(board.half[side])->attempts + sim_counts(other.half[side])->attempts;
+        packets -= sim_counts(board.half[side])->packets + sim_counts(other.half[side])->packets;
+    }
+
+    time = sim_now();
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        board_tap(&board, i % 2, sim_random() % BOARD_KEYS, time, 40 * SIM_MS, 2 * SIM_MS);
+        board_tap(&other, i % 2, sim_random() % BOARD_KEYS, time + sim_random() % (60 * SIM_MS),
+                  40 * SIM_MS, 2 * SIM_MS);
+        time += 60 * SIM_MS + sim_random() % (60 * SIM_MS);
+    }
+    sim_run_until(time + SIM_S);
+
+    for (uint32_t side = 0; side < 2; side++)
+    {
+        attempts += sim_counts(board.half[side])->attempts + sim_counts(other.half[side])->attempts;
+        packets += sim_counts(board.half[side])->packets + sim_counts(other.half[side])->packets;
+    }
+    printf("%-28s %6u packets  %6u retries  phantoms %u\n", shared ? "two boards, shared" :
+           "two boards, paired", packets, attempts - packets, board.phantoms + other.phantoms);
+    sim_config.capture = 0;
+    *packets_out = packets;
+    return attempts - packets;
+}
+
+// Paired, the boards take fewer retries for each packet, and never type on
+// each other
+static void test_crowd(void)
+{
+    uint32_t shared_packets, paired_packets;
+    uint32_t shared_retries = crowd(true, &shared_packets);
+    uint32_t paired_retries;
+
+    CHECK(shared_packets > 0);
+    CHECK(board.phantoms + other.phantoms > 0);
+
+    paired_retries = crowd(false, &paired_packets);
+    CHECK(paired_packets > 0);
+    CHECK((uint64_t)paired_retries * shared_packets < (uint64_t)shared_retries * paired_packets / 2);
+    CHECK_EQUAL(board_dropped(&board) + board_dropped(&other), 0);
+    CHECK_EQUAL(board.phantoms + other.phantoms, 0);
+}
+
+int main(void)
+{
+    test_first_boot();
+    test_retry();
+    test_second_board();
+    test_crowd();
+    return check_done("test_pairing");
+}
@@ -0,0 +1,94 @@
+#include <string.h>
+#include "check.h"
+#include "remap_reference.h"
+
+// The lookup tables against the shift and mask code they replaced. Both are
+// a bit for a bit, so every value of every input byte covers every bit and
+// any two bits of a byte together.
+
+static uint64_t state = 88172645463325252ULL;
+
+static uint32_t random32(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state >> 32;
+}
+
+static bool pack_matches(bool left, uint32_t keys)
+{
+    uint8_t reference[3], table[3];
+
+    reference_pack(left, keys, reference);
+    table_pack(left, keys, table);
+    return !memcmp(reference, table, sizeof(table));
+}
+
+static bool unpack_matches(bool left, const uint8_t *payload)
+{
+    uint8_t reference[10] = {0}, table[10] = {0};
+
+    reference_unpack(left, payload, reference);
+    table_unpack(left, payload, table);
+    return !memcmp(reference, table, sizeof(table));
+}
+
+// Switch pins into the payload bitmap, pins that aren't switches included
+static void test_pack(void)
+{
+    for (uint32_t left = 0; left < 2; left++)
+    {
+        uint32_t mismatches = 0;
+
+        for (uint32_t byte = 0; byte < 4; byte++)
+        {
+            for (uint32_t value = 0; value < 256; value++)
+            {
+                mismatches += !pack_matches(left, value << (8 * byte));
+            }
+        }
+        for (uint32_t i = 0; i < 100000; i++)
+        {
+            mismatches += !pack_matches(left, random32());
+        }
+        CHECK_EQUAL(mismatches, 0);
+    }
+}
+
+// The payload bitmap into the half's rows of data_buffer
+static void test_unpack(void)
+{
+    for (uint32_t left = 0; left < 2; left++)
+    {
+        uint32_t mismatches = 0;
+        uint8_t payload[3];
+
+        for (uint32_t byte = 0; byte < 3; byte++)
+        {
+            for (uint32_t value = 0; value < 256; value++)
+            {
+                memset(payload, 0, sizeof(payload));
+                payload[byte] = value;
+                mismatches += !unpack_matches(left, payload);
+            }
+        }
+        for (uint32_t i = 0; i < 100000; i++)
+        {
+            uint32_t word = random32();
+
+            payload[0] = word >> 16;
+            payload[1] = word >> 8;
+            payload[2] = word;
+            mismatches += !unpack_matches(left, payload);
+        }
+        CHECK_EQUAL(mismatches, 0);
+    }
+}
+
+int main(void)
+{
+    test_pack();
+    test_unpack();
+    return check_done("test_remap");
+}
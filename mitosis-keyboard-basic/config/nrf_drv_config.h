@@ -39,7 +39,9 @@
 #define RTC0_ENABLED 1
 
 #if (RTC0_ENABLED == 1)
+#ifndef RTC0_CONFIG_FREQUENCY
 #define RTC0_CONFIG_FREQUENCY	 8
+#endif
 #define RTC0_CONFIG_IRQ_PRIORITY APP_IRQ_PRIORITY_LOW
 #define RTC0_CONFIG_RELIABLE     false
 
@@ -49,7 +51,9 @@
 #define RTC1_ENABLED 1
 
 #if (RTC1_ENABLED == 1)
+#ifndef RTC1_CONFIG_FREQUENCY
 #define RTC1_CONFIG_FREQUENCY    1000
+#endif
 #define RTC1_CONFIG_IRQ_PRIORITY APP_IRQ_PRIORITY_LOW
 #define RTC1_CONFIG_RELIABLE     false
 
@@ -0,0 +1,293 @@
+#include "debounce.h"
+
+void debounce_init(debounce_t *deb)
+{
+    deb->keys = 0;
+    deb->locked = 0;
+    deb->latched = 0;
+    deb->lock_ticks = 0;
+    deb->bounces = 0;
+    debounce_profile(deb, DEBOUNCE_MODE, DEBOUNCE_PRESS, DEBOUNCE_RELEASE);
+    debounce_reset(deb);
+}
+
+void debounce_profile(debounce_t *deb, uint8_t mode, uint8_t press, uint8_t release)
+{
+    // symmetric deferral only has the one window
+    if (mode == DEBOUNCE_DEFER)
+    {
+        release = press;
+    }
+
+    // an eager lock of 0 ticks would never be reached by a per key counter,
+    // which starts at 1, and would last until it wrapped around
+    press = press ? press : 1;
+    release = release ? release : 1;
+
+    // and the counters need room for the window + 1'th sample
+#if DEBOUNCE_PER_KEY
+    press = (press > DEBOUNCE_MAX) ? DEBOUNCE_MAX : press;
+    release = (release > DEBOUNCE_MAX) ? DEBOUNCE_MAX : release;
+#endif
+
+    deb->mode = mode;
+    deb->press = press;
+    deb->release = release;
+}
+
+void debounce_reset(debounce_t *deb)
+{
+    deb->debouncing = false;
+    deb->debounce_ticks = 0;
+    deb->activity_ticks = 0;
+    deb->edge_ticks = 0;
+    deb->moving = 0;
+
+    for (uint32_t i = 0; i < DEBOUNCE_PLANES; i++)
+    {
+        deb->count[i] = 0;
+    }
+}
+
+void debounce_resume(debounce_t *deb, uint32_t keys)
+{
+    debounce_reset(deb);
+    deb->keys = keys;
+
+    // locked as any eager press would be, so their bounces can't release them
+    if (deb->mode == DEBOUNCE_EAGER)
+    {
+        deb->locked = keys;
+        deb->lock_ticks = deb->press;
+    }
+}
+
+void debounce_latch(debounce_t *deb, uint32_t keys)
+{
+    deb->latched |= keys & ~deb->keys;
+}
+
+#if DEBOUNCE_PER_KEY
+
+static void count_clear(uint32_t *count, uint32_t keys)
+{
+    for (uint32_t i = 0; i < DEBOUNCE_PLANES; i++)
+    {
+        count[i] &= ~keys;
+    }
+}
+
+// Add one to the counters of keys, a ripple carry through the bit planes
+static void count_increment(uint32_t *count, uint32_t keys)
+{
+    uint32_t carry = keys;
+
+    for (uint32_t i = 0; i < DEBOUNCE_PLANES; i++)
+    {
+        uint32_t next = count[i] & carry;
+        count[i] ^= carry;
+        carry = next;
+    }
+}
+
+// Keys in each of the three groups whose counters equal that group's value
+static uint32_t count_reached(const uint32_t *count,
+                              uint32_t locked, uint8_t lock_value,
+                              uint32_t pressing, uint8_t press_value,
+                              uint32_t releasing, uint8_t release_value)
+{
+    uint32_t equal = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < DEBOUNCE_PLANES; i++)
+    {
+        uint32_t want = ((lock_value >> i & 1) ? locked : 0) |
+                        ((press_value >> i & 1) ? pressing : 0) |
+                        ((release_value >> i & 1) ? releasing : 0);
+
+        equal &= ~(count[i] ^ want);
+    }
+
+    return equal & (locked | pressing | releasing);
+}
+
+// Every key counts its own stable ticks, so chatter on one key leaves the
+// others alone. A key that has moved needs window + 1 matching samples, the
+// same as the whole matrix version, and an eager lock lasts press ticks.
+uint32_t debounce_tick(debounce_t *deb, uint32_t sample)
+{
+    uint32_t changed = 0;
+    uint32_t pressed = 0;
+    uint32_t moving, counting, settled, unlocked, reverted;
+
+    // latched keys stay pressed until they have been sent as such
+    sample |= deb->latched;
+
+    if (deb->moving || ((sample ^ deb->keys) & ~deb->locked))
+    {
+        deb->edge_ticks++;
+    }
+    else
+    {
+        deb->edge_ticks = 0;
+    }
+
+    if (deb->mode == DEBOUNCE_EAGER)
+    {
+        pressed = sample & ~deb->keys & ~deb->locked;
+        deb->keys |= pressed;
+        deb->locked |= pressed;
+        changed = pressed;
+    }
+
+    // count keys that are locked, or whose samples differ from their state,
+    // starting afresh for any that stopped, or were only just locked
+    moving = (sample ^ deb->keys) & ~deb->locked;
+    counting = moving | (deb->locked & ~pressed);
+    count_clear(deb->count, ~counting);
+    count_increment(deb->count, counting);
+
+    settled = count_reached(deb->count,
+                            deb->locked & ~pressed, deb->press,
+                            moving & sample, deb->press + 1,
+                            moving & ~sample, deb->release + 1);
+
+    unlocked = settled & deb->locked;
+    settled &= moving;
+    deb->locked &= ~unlocked;
+    deb->keys ^= settled;
+    changed |= settled;
+    count_clear(deb->count, settled | unlocked);
+
+    // keys that were moving, and went back without settling
+    reverted = deb->moving & ~moving & ~settled;
+    deb->moving = moving & ~settled;
+    while (reverted)
+    {
+        reverted &= reverted - 1;
+        deb->bounces++;
+    }
+    deb->latched &= ~deb->keys;
+
+    return changed;
+}
+
+#else
+
+// Report presses on their first sample, then hold them for the lock out
+// window, so that the bounces that follow can't release them. Returns the
+// newly pressed keys, and masks locked keys in the sample with their state.
+static uint32_t eager_press(debounce_t *deb, uint32_t *sample)
+{
+    uint32_t pressed;
+
+    if (deb->lock_ticks && --deb->lock_ticks == 0)
+    {
+        deb->locked = 0;
+    }
+
+    pressed = *sample & ~deb->keys & ~deb->locked;
+    if (pressed)
+    {
+        deb->keys |= pressed;
+        deb->locked |= pressed;
+        deb->lock_ticks = deb->press;
+    }
+
+    *sample = (*sample & ~deb->locked) | (deb->keys & deb->locked);
+
+    return pressed;
+}
+
+uint32_t debounce_tick(debounce_t *deb, uint32_t sample)
+{
+    uint32_t changed = 0;
+    uint32_t window;
+
+    // latched keys stay pressed until they have been sent as such
+    sample |= deb->latched;
+
+    // timing from the first sample that differs from the keys sent, carrying
+    // on through any restarts of the debounce period
+    if (deb->debouncing || deb->keys != sample)
+    {
+        deb->edge_ticks++;
+    }
+    else
+    {
+        deb->edge_ticks = 0;
+    }
+
+    if (deb->mode == DEBOUNCE_EAGER)
+    {
+        changed = eager_press(deb, &sample);
+    }
+
+    // debouncing, waits until there have been no transitions in 5ms (assuming five 1ms ticks)
+    if (deb->debouncing)
+    {
+        // if debouncing, check if current keystates equal to the snapshot
+        if (deb->snapshot == sample)
+        {
+            // presses wait for the press window, anything else on the release one
+            window = (deb->snapshot & ~deb->keys) ? deb->press : deb->release;
+
+            // window ticks of stable sampling needed before sending data
+            deb->debounce_ticks++;
+            if (deb->debounce_ticks >= window)
+            {
+                changed |= deb->keys ^ deb->snapshot;
+                deb->keys = deb->snapshot;
+                deb->debouncing = false;
+            }
+        }
+        else
+        {
+            // if keys change, start period again
+            deb->debouncing = false;
+
+            // back where it started, the change was too short to be sent
+            if (deb->keys == sample)
+            {
+                deb->bounces++;
+            }
+        }
+    }
+    else
+    {
+        // if the keystate is different from the last data
+        // sent to the receiver, start debouncing
+        if (deb->keys != sample)
+        {
+            deb->snapshot = sample;
+            deb->debouncing = true;
+            deb->debounce_ticks = 0;
+        }
+    }
+    deb->latched &= ~deb->keys;
+
+    return changed;
+}
+
+#endif
+
+bool debounce_idle(debounce_t *deb, uint32_t sample)
+{
+    // looking for ACTIVITY ticks of no keys pressed, to go back to deep sleep
+    if (sample == 0)
+    {
+        deb->activity_ticks++;
+        return deb->activity_ticks > ACTIVITY;
+    }
+
+    deb->activity_ticks = 0;
+    return false;
+}
+
+bool debounce_pending(const debounce_t *deb)
+{
+#if DEBOUNCE_PER_KEY
+    return deb->moving || deb->locked || deb->latched;
+#else
+    return deb->debouncing || deb->lock_ticks || deb->latched;
+#endif
+}
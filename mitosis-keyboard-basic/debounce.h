@@ -0,0 +1,95 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Keystate debouncing and sleep timing, fed one sample of the switches per
+// tick. Nothing here touches the hardware, so it builds for any target.
+
+// Debounce time (dependent on tick frequency)
+#ifndef DEBOUNCE
+#define DEBOUNCE 5
+#endif
+
+// Separate press and release windows, for DEBOUNCE_ASYM and DEBOUNCE_EAGER
+#ifndef DEBOUNCE_PRESS
+#define DEBOUNCE_PRESS DEBOUNCE
+#endif
+#ifndef DEBOUNCE_RELEASE
+#define DEBOUNCE_RELEASE DEBOUNCE
+#endif
+
+// Debounce algorithms
+#define DEBOUNCE_DEFER  0   ///< send changes once stable for DEBOUNCE ticks
+#define DEBOUNCE_ASYM   1   ///< as DEFER, waiting DEBOUNCE_PRESS for presses and DEBOUNCE_RELEASE for releases
+#define DEBOUNCE_EAGER  2   ///< send presses on the first edge, locking the key for DEBOUNCE_PRESS ticks,
+                            ///< releases once stable for DEBOUNCE_RELEASE
+
+#ifndef DEBOUNCE_MODE
+#define DEBOUNCE_MODE DEBOUNCE_DEFER
+#endif
+
+// Debounce each key on its own, rather than waiting for the whole matrix to
+// be stable. Per key counters are bit sliced, one word per counter bit, which
+// limits the windows to DEBOUNCE_MAX ticks.
+#ifndef DEBOUNCE_PER_KEY
+#define DEBOUNCE_PER_KEY 1
+#endif
+
+#define DEBOUNCE_PLANES 4
+#define DEBOUNCE_MAX    ((1 << DEBOUNCE_PLANES) - 2)
+
+// Ticks with no keys pressed before going back to sleep
+#ifndef ACTIVITY
+#define ACTIVITY 500
+#endif
+
+typedef struct
+{
+    uint32_t keys;              ///< debounced keystates, as last sent to the receiver
+    uint32_t snapshot;          ///< keystates waiting to be stable, whole matrix
+    uint32_t moving;            ///< keys whose samples differ from keys, per key
+    uint32_t count[DEBOUNCE_PLANES]; ///< per key tick counters, bit i of each in count[i]
+    uint32_t locked;            ///< eagerly pressed keys, ignoring their switch until lock_ticks run out
+    uint32_t latched;           ///< keys pressed at a wake edge, sampled as pressed until debounced as such
+    uint32_t debounce_ticks;
+    uint32_t lock_ticks;
+    uint32_t activity_ticks;
+    uint32_t edge_ticks;        ///< ticks since the samples first moved away from keys
+    uint32_t bounces;           ///< changes that reverted before they were stable, filtered out as chatter
+    bool     debouncing;
+    uint8_t  mode;              ///< one of the DEBOUNCE_ algorithms
+    uint8_t  press;             ///< ticks to wait on a press, or lock a key for when eager
+    uint8_t  release;           ///< ticks to wait on a release
+} debounce_t;
+
+// Set up with the compile time algorithm and windows
+void debounce_init(debounce_t *deb);
+
+// Switch algorithm, or windows, at run time. Windows are at least 1 tick,
+// and at most DEBOUNCE_MAX debouncing per key.
+void debounce_profile(debounce_t *deb, uint8_t mode, uint8_t press, uint8_t release);
+
+// Start debouncing afresh, after waking up
+void debounce_reset(debounce_t *deb);
+
+// Take keys as pressed and already sent, after waking from System OFF to them
+void debounce_resume(debounce_t *deb, uint32_t keys);
+
+// Latch the keys pressed at the edge that woke the half, so that a tap released
+// before the debounce has seen it is still sent, as a press then a release
+void debounce_latch(debounce_t *deb, uint32_t keys);
+
+// Take a sample of the keys, returning the keys whose debounced state changed.
+// edge_ticks then holds how long the change took to get through, counting the
+// tick it was first seen on.
+uint32_t debounce_tick(debounce_t *deb, uint32_t sample);
+
+// Count idle ticks, returning true once there have been enough to sleep
+bool debounce_idle(debounce_t *deb, uint32_t sample);
+
+// True while a key is still waiting out a debounce or lock out window
+bool debounce_pending(const debounce_t *deb);
+
+#endif
@@ -1,275 +1,1036 @@
-
-#define COMPILE_RIGHT
-//#define COMPILE_LEFT
-
-#include "mitosis.h"
-#include "nrf_drv_config.h"
-#include "nrf_gzll.h"
-#include "nrf_gpio.h"
-#include "nrf_delay.h"
-#include "nrf_drv_clock.h"
-#include "nrf_drv_rtc.h"
-
-
-/*****************************************************************************/
-/** Configuration */
-/*****************************************************************************/
-
-const nrf_drv_rtc_t rtc_maint = NRF_DRV_RTC_INSTANCE(0); /**< Declaring an instance of nrf_drv_rtc for RTC0. */
-const nrf_drv_rtc_t rtc_deb = NRF_DRV_RTC_INSTANCE(1); /**< Declaring an instance of nrf_drv_rtc for RTC1. */
-
-
-// Define payload length
-#define TX_PAYLOAD_LENGTH 3 ///< 3 byte payload length when transmitting
-
-// Data and acknowledgement payloads
-static uint8_t data_payload[TX_PAYLOAD_LENGTH];                ///< Payload to send to Host. 
-static uint8_t ack_payload[NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH]; ///< Placeholder for received ACK payloads from Host.
-
-// Debounce time (dependent on tick frequency)
-#define DEBOUNCE 5
-#define ACTIVITY 500
-
-// Key buffers
-static uint32_t keys, keys_snapshot;
-static uint32_t debounce_ticks, activity_ticks;
-static volatile bool debouncing = false;
-
-// Debug helper variables
-static volatile bool init_ok, enable_ok, push_ok, pop_ok, tx_success;  
-
-// Setup switch pins with pullups
-static void gpio_config(void)
-{
-    nrf_gpio_cfg_sense_input(S01, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S02, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S03, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S04, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S05, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S06, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S07, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S08, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S09, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S10, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S11, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S12, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S13, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S14, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S15, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S16, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S17, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S18, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S19, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S20, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S21, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S22, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-    nrf_gpio_cfg_sense_input(S23, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
-}
-
-// Return the key states, masked with valid key pins
-static uint32_t read_keys(void)
-{
-    return ~NRF_GPIO->IN & INPUT_MASK;
-}
-
-// Assemble packet and send to receiver
-static void send_data(void)
-{
-    data_payload[0] = ((keys & 1<<S01) ? 1:0) << 7 | \
-                      ((keys & 1<<S02) ? 1:0) << 6 | \
-                      ((keys & 1<<S03) ? 1:0) << 5 | \
-                      ((keys & 1<<S04) ? 1:0) << 4 | \
-                      ((keys & 1<<S05) ? 1:0) << 3 | \
-                      ((keys & 1<<S06) ? 1:0) << 2 | \
-                      ((keys & 1<<S07) ? 1:0) << 1 | \
-                      ((keys & 1<<S08) ? 1:0) << 0;
-
-    data_payload[1] = ((keys & 1<<S09) ? 1:0) << 7 | \
-                      ((keys & 1<<S10) ? 1:0) << 6 | \
-                      ((keys & 1<<S11) ? 1:0) << 5 | \
-                      ((keys & 1<<S12) ? 1:0) << 4 | \
-                      ((keys & 1<<S13) ? 1:0) << 3 | \
-                      ((keys & 1<<S14) ? 1:0) << 2 | \
-                      ((keys & 1<<S15) ? 1:0) << 1 | \
-                      ((keys & 1<<S16) ? 1:0) << 0;
-
-    data_payload[2] = ((keys & 1<<S17) ? 1:0) << 7 | \
-                      ((keys & 1<<S18) ? 1:0) << 6 | \
-                      ((keys & 1<<S19) ? 1:0) << 5 | \
-                      ((keys & 1<<S20) ? 1:0) << 4 | \
-                      ((keys & 1<<S21) ? 1:0) << 3 | \
-                      ((keys & 1<<S22) ? 1:0) << 2 | \
-                      ((keys & 1<<S23) ? 1:0) << 1 | \
-                      0 << 0;
-
-    nrf_gzll_add_packet_to_tx_fifo(PIPE_NUMBER, data_payload, TX_PAYLOAD_LENGTH);
-}
-
-// 8Hz held key maintenance, keeping the reciever keystates valid
-static void handler_maintenance(nrf_drv_rtc_int_type_t int_type)
-{
-    send_data();
-}
-
-// 1000Hz debounce sampling
-static void handler_debounce(nrf_drv_rtc_int_type_t int_type)
-{
-    // debouncing, waits until there have been no transitions in 5ms (assuming five 1ms ticks)
-    if (debouncing)
-    {
-        // if debouncing, check if current keystates equal to the snapshot
-        if (keys_snapshot == read_keys())
-        {
-            // DEBOUNCE ticks of stable sampling needed before sending data
-            debounce_ticks++;
-            if (debounce_ticks == DEBOUNCE)
-            {
-                keys = keys_snapshot;
-                send_data();
-            }
-        }
-        else
-        {
-            // if keys change, start period again
-            debouncing = false;
-        }
-    }
-    else
-    {
-        // if the keystate is different from the last data
-        // sent to the receiver, start debouncing
-        if (keys != read_keys())
-        {
-            keys_snapshot = read_keys();
-            debouncing = true;
-            debounce_ticks = 0;
-        }
-    }
-
-    // looking for 500 ticks of no keys pressed, to go back to deep sleep
-    if (read_keys() == 0)
-    {
-        activity_ticks++;
-        if (activity_ticks > ACTIVITY)
-        {
-            nrf_drv_rtc_disable(&rtc_maint);
-            nrf_drv_rtc_disable(&rtc_deb);
-        }
-    }
-    else
-    {
-        activity_ticks = 0;
-    }
-
-}
-
-
-// Low frequency clock configuration
-static void lfclk_config(void)
-{
-    nrf_drv_clock_init();
-
-    nrf_drv_clock_lfclk_request(NULL);
-}
-
-// RTC peripheral configuration
-static void rtc_config(void)
-{
-    //Initialize RTC instance
-    nrf_drv_rtc_init(&rtc_maint, NULL, handler_maintenance);
-    nrf_drv_rtc_init(&rtc_deb, NULL, handler_debounce);
-
-    //Enable tick event & interrupt
-    nrf_drv_rtc_tick_enable(&rtc_maint,true);
-    nrf_drv_rtc_tick_enable(&rtc_deb,true);
-
-    //Power on RTC instance
-    //nrf_drv_rtc_enable(&rtc_maint);
-    //nrf_drv_rtc_enable(&rtc_deb);
-}
-
-int main()
-{
-    // Initialize Gazell
-    nrf_gzll_init(NRF_GZLL_MODE_DEVICE);
-    
-    // Attempt sending every packet up to 100 times    
-    nrf_gzll_set_max_tx_attempts(100);
-
-    // Addressing
-    nrf_gzll_set_base_address_0(0x01020304);
-    nrf_gzll_set_base_address_1(0x05060708);
-
-    // Enable Gazell to start sending over the air
-    nrf_gzll_enable();
-
-    // Configure 32kHz xtal oscillator
-    lfclk_config(); 
-
-    // Configure RTC peripherals with ticks
-    rtc_config();
-
-    // Configure all keys as inputs with pullups
-    gpio_config();
-
-    // Set the GPIOTE PORT event as interrupt source, and enable interrupts for GPIOTE
-    NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Msk;
-    NVIC_EnableIRQ(GPIOTE_IRQn);
-
-
-    // Main loop, constantly sleep, waiting for RTC and gpio IRQs
-    while(1)
-    {
-        __SEV();
-        __WFE();
-        __WFE(); 
-    }
-}
-
-// This handler will be run after wakeup from system ON (GPIO wakeup)
-void GPIOTE_IRQHandler(void)
-{
-    if(NRF_GPIOTE->EVENTS_PORT)
-    {
-        //clear wakeup event
-        NRF_GPIOTE->EVENTS_PORT = 0;
-
-        //enable rtc interupt triggers
-        nrf_drv_rtc_enable(&rtc_maint);
-        nrf_drv_rtc_enable(&rtc_deb);
-
-        debouncing = false;
-        debounce_ticks = 0;
-        activity_ticks = 0;
-    }
-}
-
-
-
-/*****************************************************************************/
-/** Gazell callback function definitions  */
-/*****************************************************************************/
-
-void  nrf_gzll_device_tx_success(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info)
-{
-    uint32_t ack_payload_length = NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH;    
-
-    if (tx_info.payload_received_in_ack)
-    {
-        // Pop packet and write first byte of the payload to the GPIO port.
-        nrf_gzll_fetch_packet_from_rx_fifo(pipe, ack_payload, &ack_payload_length);
-    }
-}
-
-// no action is taken when a packet fails to send, this might need to change
-void nrf_gzll_device_tx_failed(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info)
-{
-    
-}
-
-// Callbacks not needed
-void nrf_gzll_host_rx_data_ready(uint32_t pipe, nrf_gzll_host_rx_info_t rx_info)
-{}
-void nrf_gzll_disabled()
-{}
-
+//#define COMPILE_LEFT
+
+// the right half unless the left is asked for, here or with -DCOMPILE_LEFT
+#ifndef COMPILE_LEFT
+#define COMPILE_RIGHT
+#endif
+
+#include "mitosis.h"
+#include "mitosis_protocol.h"
+#include "mitosis_matrix.h"
+#include "debounce.h"
+#include "packet.h"
+#include "latency.h"
+#include "pairing.h"
+#include "powerstats.h"
+#include "nrf_drv_config.h"
+#include "nrf_gzll.h"
+#include "nrf_gpio.h"
+#include "nrf_delay.h"
+#include "nrf_drv_clock.h"
+#include "nrf_drv_rtc.h"
+#include "app_util_platform.h"
+
+// Sample the switches from their edges, with RTC1 only running while a
+// debounce is pending, rather than polling until ACTIVITY idle ticks pass
+#ifndef SAMPLE_ON_EDGE
+#define SAMPLE_ON_EDGE 0
+#endif
+
+// Longest gap between keepalives of held keys, in maintenance ticks, unless
+// the receiver asks for another. The gap starts at one tick after every
+// change, and doubles up to this.
+#ifndef KEEPALIVE_MAX
+#define KEEPALIVE_MAX 16
+#endif
+
+// Switch held at power on to pair again, and maintenance ticks to keep asking
+// for the receiver's addresses before going back to the old ones
+#ifndef PAIRING_KEY
+#define PAIRING_KEY S01
+#endif
+#ifndef PAIRING_TICKS
+#define PAIRING_TICKS (30 * RTC0_CONFIG_FREQUENCY)
+#endif
+
+// Maintenance ticks between reports of the radio link to the receiver, sent
+// only while the counts are changing
+#ifndef TELEMETRY_TICKS
+#define TELEMETRY_TICKS (10 * RTC0_CONFIG_FREQUENCY)
+#endif
+
+// Seconds a line up with the receiver's clock is trusted for, as the two
+// crystals drift apart by up to 40ppm, before events go out unstamped
+#ifndef SYNC_EXPIRY
+#define SYNC_EXPIRY 60
+#endif
+
+// Seconds idle before powering down to System OFF, which a switch wakes the
+// half from with a reset, or 0 to stay in System ON. By then the receiver's
+// clock is no longer trusted anyway.
+#ifndef SYSTEM_OFF_DELAY
+#define SYSTEM_OFF_DELAY SYNC_EXPIRY
+#endif
+
+// Count the CPU cycles the remap of the keystates takes in send_events() on
+// TIMER1, into remap_cycles, for reading with gdb
+#ifndef REMAP_CYCLES
+#define REMAP_CYCLES 0
+#endif
+
+#if TELEMETRY_PAYLOAD_LENGTH > PAYLOAD_MAX_LENGTH
+#error "telemetry must fit in data_payload"
+#endif
+#if POWER_PAYLOAD_LENGTH > PAYLOAD_MAX_LENGTH
+#error "power stats must fit in data_payload"
+#endif
+#if PAYLOAD_MAX_LENGTH > NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH
+#error "payloads must fit in a Gazell packet"
+#endif
+
+/*****************************************************************************/
+/** Configuration */
+/*****************************************************************************/
+
+const nrf_drv_rtc_t rtc_maint = NRF_DRV_RTC_INSTANCE(0); /**< Declaring an instance of nrf_drv_rtc for RTC0. */
+const nrf_drv_rtc_t rtc_deb = NRF_DRV_RTC_INSTANCE(1); /**< Declaring an instance of nrf_drv_rtc for RTC1. */
+
+
+// Data and acknowledgement payloads
+static uint8_t data_payload[PAYLOAD_MAX_LENGTH];               ///< Payload to send to Host.
+static uint8_t ack_payload[NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH]; ///< Placeholder for received ACK payloads from Host.
+
+// Key buffers
+static debounce_t deb;
+
+// Latency from a switch moving to its packet being queued, in debounce ticks,
+// with dropped counting the packets the full TX FIFO refused. Chatter the
+// debounce filtered out is counted apart, in deb.bounces.
+static latency_t key_latency = LATENCY_INIT(0);
+
+// Attempts and channel switches of every packet, and those Gazell gave up on
+static link_stats_t link_stats;
+static volatile bool link_changed;      ///< counted since the last report
+static uint32_t telemetry_ticks;
+
+// Sequence number given to the next key event, kept through System OFF so the
+// receiver doesn't take the events after a wake for stale ones
+static uint8_t sequence __attribute__((section(".noinit")));
+
+// Time from waking up from System OFF to the waking keys being acknowledged,
+// in 1us TIMER0 ticks, counted through every wake
+static latency_t wake_latency __attribute__((section(".noinit")));
+static volatile bool wake_pending;      ///< the waking keys are on their way
+
+// Keepalive backoff, in maintenance ticks
+static uint32_t keepalive_ticks, keepalive_gap = 1;
+static volatile bool resync = true;     ///< a packet may have been lost, send the full keystates
+
+// Settings from the receiver, in the ACK payloads
+static volatile uint32_t keepalive_max = KEEPALIVE_MAX;
+static volatile bool resend;            ///< the receiver lost track, send the keystates now
+static volatile bool profile_request;   ///< a new debounce profile, for the debounce tick
+static volatile uint8_t profile[3] = { CONTROL_DEBOUNCE_OWN };  ///< algorithm, press and release windows
+
+// The half's clock, RTC1 counting from power on with only its tick stopped
+// while idle, and the receiver's timebase lined up against it from the ACKs
+static uint32_t clock_base;             ///< counts lost to clearing RTC1, and its overflows
+static uint32_t delivered;              ///< clock when the last packet was delivered
+static bool delivered_valid;            ///< and the next ACK has the receiver's time for it
+static volatile uint32_t sync_clock, sync_time; ///< a clock reading, and the receiver's time at it
+static volatile bool synced;
+
+// The receiver's addresses, and the pairing session asking for them
+static pairing_t pairing;
+static uint8_t tx_pipe;                 ///< the pipe the receiver gave the half, PAIRING_PIPE while asking
+static uint32_t pairing_ticks;          ///< maintenance ticks left asking to pair
+static volatile bool paired_received;   ///< the receiver's addresses arrived in an ACK
+static volatile uint8_t paired_pipe;    ///< along with the pipe given
+static volatile bool pairing_done;      ///< and are stored and in use
+static volatile bool readdress;         ///< the radio should go back to the stored addresses
+static volatile bool pairing_failed;    ///< a session ran out with none stored, lit on the LED
+
+// Which ticks are running, and where the time goes, in RAM the startup code
+// leaves alone so the counts carry on through resets
+static volatile bool maintaining;       ///< RTC0 is running
+static volatile bool sampling;          ///< RTC1 is ticking
+static power_stats_t power __attribute__((section(".noinit")));
+
+#if REMAP_CYCLES
+static uint32_t remap_cycles;           ///< last remap of both words, less the capture overhead
+#endif
+
+#if SAMPLE_ON_EDGE
+static uint32_t armed;                  ///< key states the pin senses are armed against
+static uint32_t settled;                ///< clock when sampling last stopped
+#endif
+
+// Payload bitmap bit of each switch pin, generating the pin lookup table
+#define PIN_MAP(pin) PIN_WIRE_MAP(S, pin)
+
+static const uint32_t pin_lut[8][16] = NIBBLE_LUT_32(PIN_MAP);
+
+// Debug helper variables
+static volatile bool init_ok, enable_ok, push_ok, pop_ok, tx_success;  
+
+// Setup switch pins with pullups, and the LED
+static void gpio_config(void)
+{
+    nrf_gpio_cfg_output(LED_PIN);
+
+    nrf_gpio_cfg_sense_input(S01, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S02, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S03, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S04, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S05, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S06, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S07, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S08, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S09, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S10, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S11, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S12, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S13, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S14, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S15, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S16, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S17, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S18, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S19, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S20, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S21, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S22, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+    nrf_gpio_cfg_sense_input(S23, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+}
+
+// Return the key states, masked with valid key pins
+static uint32_t read_keys(void)
+{
+    return ~NRF_GPIO->IN & INPUT_MASK;
+}
+
+#if SAMPLE_ON_EDGE
+// Point the sense of every switch that moved at its opposite level, so the
+// PORT event fires on the next edge of any switch, pressed or released
+static void sense_arm(uint32_t sample)
+{
+    uint32_t moved = sample ^ armed;
+
+    for (uint32_t pin = 0; moved; pin++)
+    {
+        if (moved & (1UL << pin))
+        {
+            nrf_gpio_cfg_sense_set(pin, (sample & (1UL << pin)) ? NRF_GPIO_PIN_SENSE_HIGH
+                                                                : NRF_GPIO_PIN_SENSE_LOW);
+            moved &= ~(1UL << pin);
+        }
+    }
+    armed = sample;
+}
+#endif
+
+// RTC1 ticks since power on
+static uint32_t clock_now(void)
+{
+    uint32_t count = nrf_drv_rtc_counter_get(&rtc_deb);
+
+    // the counter has wrapped, and the interrupt carrying it into clock_base
+    // hasn't run yet
+    if (nrf_rtc_event_pending(rtc_deb.p_reg, NRF_RTC_EVENT_OVERFLOW) &&
+        count < RTC_COUNTER_COUNTER_Msk / 2)
+    {
+        count += RTC_COUNTER_COUNTER_Msk + 1;
+    }
+
+    return clock_base + count;
+}
+
+// The rate RTC1 really ticks at, the crystal divided by a whole prescaler, so
+// 1024Hz for RTC1_CONFIG_FREQUENCY 1000
+#define CLOCK_HZ (RTC_INPUT_FREQ / (RTC_FREQ_TO_PRESCALER(RTC1_CONFIG_FREQUENCY) + 1))
+
+// Clock ticks in receiver timebase ticks, without overflowing at any tick rate
+static uint32_t clock_to_timebase(uint32_t ticks)
+{
+    return ticks / CLOCK_HZ * TIMEBASE_HZ + ticks % CLOCK_HZ * TIMEBASE_HZ / CLOCK_HZ;
+}
+
+// The receiver's time some clock ticks ago, false if the clocks were not lined
+// up recently enough to trust
+static bool receiver_time(uint32_t ago, uint32_t *time)
+{
+    uint32_t clock, elapsed;
+    bool valid;
+
+    CRITICAL_REGION_ENTER();
+    valid = synced;
+    clock = sync_clock;
+    *time = sync_time;
+    CRITICAL_REGION_EXIT();
+
+    elapsed = clock_now() - clock;
+    if (!valid || elapsed > SYNC_EXPIRY * CLOCK_HZ)
+    {
+        return false;
+    }
+
+    *time = (*time + clock_to_timebase(elapsed) - clock_to_timebase(ago)) & TIMEBASE_MASK;
+    return true;
+}
+
+// Count down to System OFF while idle, on RTC1's first compare channel
+static void off_countdown(bool idle)
+{
+#if SYSTEM_OFF_DELAY
+    if (idle)
+    {
+        nrf_drv_rtc_cc_set(&rtc_deb, 0, (nrf_drv_rtc_counter_get(&rtc_deb) +
+                           SYSTEM_OFF_DELAY * RTC1_CONFIG_FREQUENCY) & RTC_COUNTER_COUNTER_Msk, true);
+    }
+    else
+    {
+        nrf_drv_rtc_cc_disable(&rtc_deb, 0);
+    }
+#endif
+}
+
+// Start and stop the maintenance and debounce ticks, counting the time spent
+// in each power state, and counting down to System OFF in the idle one
+static void ticks(bool maintenance, bool debounce)
+{
+    CRITICAL_REGION_ENTER();
+    if ((maintenance || debounce) != (maintaining || sampling))
+    {
+        off_countdown(!maintenance && !debounce);
+    }
+    if (maintenance != maintaining)
+    {
+        if (maintenance)
+        {
+            nrf_drv_rtc_enable(&rtc_maint);
+        }
+        else
+        {
+            nrf_drv_rtc_disable(&rtc_maint);
+        }
+        maintaining = maintenance;
+    }
+    if (debounce != sampling)
+    {
+        if (debounce)
+        {
+            nrf_drv_rtc_tick_enable(&rtc_deb, true);
+        }
+        else
+        {
+            nrf_drv_rtc_tick_disable(&rtc_deb);
+        }
+        sampling = debounce;
+    }
+
+    power_stats_enter(&power, debounce ? POWER_SAMPLING : maintenance ? POWER_HELD : POWER_IDLE,
+                      clock_now());
+    CRITICAL_REGION_EXIT();
+}
+
+// Keep held keys alive on the receiver, telling it when to expect the next
+// keepalive. The full keystates are only sent when a packet may have gone
+// missing, otherwise the short unchanged form is enough.
+static void send_keepalive(void)
+{
+    uint32_t length;
+
+    if (resync)
+    {
+        resync = false;
+        length = packet_state(data_payload, lut_remap(pin_lut, deb.keys, 8), sequence);
+    }
+    else
+    {
+        length = packet_unchanged(data_payload, sequence,
+                                  keepalive_gap * 1000 / RTC0_CONFIG_FREQUENCY);
+    }
+
+    if (!nrf_gzll_add_packet_to_tx_fifo(tx_pipe, data_payload, length))
+    {
+        resync = true;
+    }
+}
+
+#if REMAP_CYCLES
+// TIMER1 counting CPU cycles, as the Cortex-M0 has no DWT cycle counter. It
+// runs from the 16MHz HFCLK unprescaled, and Gazell only uses TIMER2.
+static void cycle_timer_start(void)
+{
+    NRF_TIMER1->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER1->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    NRF_TIMER1->PRESCALER = 0;
+    NRF_TIMER1->TASKS_CLEAR = 1;
+    NRF_TIMER1->TASKS_START = 1;
+}
+
+// Cycles since cycle_timer_start(), less those of starting and capturing with
+// nothing in between, measured the same way on the first call
+static uint32_t cycle_timer_stop(void)
+{
+    static uint32_t overhead = UINT32_MAX;
+    uint32_t cycles;
+
+    NRF_TIMER1->TASKS_CAPTURE[0] = 1;
+    cycles = NRF_TIMER1->CC[0];
+    NRF_TIMER1->TASKS_SHUTDOWN = 1;
+
+    if (overhead == UINT32_MAX)
+    {
+        overhead = 0;
+        cycle_timer_start();
+        overhead = cycle_timer_stop();
+    }
+
+    return cycles - overhead;
+}
+#endif
+
+// Send a press or release event for every changed key, along with the keystates,
+// stamped with the tick the first of them was seen to move on
+static void send_events(uint32_t changed)
+{
+#if REMAP_CYCLES
+    cycle_timer_start();
+#endif
+    uint32_t wire = lut_remap(pin_lut, deb.keys, 8);
+    uint32_t moved = lut_remap(pin_lut, changed, 8);
+    uint32_t stamp, length;
+#if REMAP_CYCLES
+    remap_cycles = cycle_timer_stop();
+#endif
+
+    if (receiver_time(deb.edge_ticks ? deb.edge_ticks - 1 : 0, &stamp))
+    {
+        length = packet_stamped(data_payload, wire, moved, &sequence, stamp);
+    }
+    else
+    {
+        length = packet_events(data_payload, wire, moved, &sequence);
+    }
+
+    if (nrf_gzll_add_packet_to_tx_fifo(tx_pipe, data_payload, length))
+    {
+        latency_record(&key_latency, deb.edge_ticks);
+    }
+    else
+    {
+        key_latency.dropped++;
+        resync = true;
+    }
+
+    // keepalives start over from the shortest gap
+    keepalive_ticks = 0;
+    keepalive_gap = 1;
+}
+
+// Ask the receiver for its addresses every maintenance tick, until they are
+// in use or the session runs out. Every half asks on the same pipe, and the
+// answer to a request rides on the ACK of the next one, so each tick asks
+// twice in a row, before another half's request can take it.
+static void pairing_tick(void)
+{
+    if (!pairing_done && --pairing_ticks)
+    {
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            nrf_gzll_add_packet_to_tx_fifo(tx_pipe, data_payload,
+                                           packet_pair(data_payload, NRF_FICR->DEVICEID[0],
+                                                       SIDE_NUMBER));
+        }
+        return;
+    }
+
+    // given up, so back to the addresses of the last pairing. With none, the
+    // shared addresses are no use for typing, so the LED lights up until the
+    // next key pressed starts another session.
+    if (!pairing_done && pairing.magic == PAIRING_MAGIC)
+    {
+        readdress = true;
+    }
+    else if (!pairing_done)
+    {
+        pairing_failed = true;
+        nrf_gpio_pin_set(LED_PIN);
+    }
+
+    // the tick was only kept running for pairing
+    pairing_ticks = 0;
+    if (!deb.keys && !debounce_pending(&deb) && !resync)
+    {
+        ticks(false, sampling);
+    }
+}
+
+// Start another session on a key pressed after one failed
+static void pairing_retry(void)
+{
+    if (pairing_failed)
+    {
+        pairing_failed = false;
+        nrf_gpio_pin_clear(LED_PIN);
+        pairing_ticks = PAIRING_TICKS;
+        ticks(true, sampling);
+    }
+}
+
+#if SYSTEM_OFF_DELAY
+// Power down to System OFF after a long idle, unless something still needs
+// the half awake. Any switch pressed wakes it with a reset, into main.
+static void system_off(void)
+{
+    CRITICAL_REGION_ENTER();
+    if (maintaining || sampling)
+    {
+        // woken up since, and counting down again once idle
+    }
+    else if (read_keys() || paired_received || readdress ||
+             nrf_gzll_get_tx_fifo_packet_count(tx_pipe))
+    {
+        // packets still to go, or the radio to move, so another countdown
+        off_countdown(true);
+    }
+    else
+    {
+        power_stats_off(&power, clock_now());
+
+        // the pins hold their state through System OFF, so the LED would stay
+        // lit. A half that failed to pair tries again when it wakes.
+        nrf_gpio_pin_clear(LED_PIN);
+
+#if SAMPLE_ON_EDGE
+        sense_arm(0);
+#endif
+
+        // keeping both RAM blocks, for the .noinit counts. A switch pressed
+        // since it was read wakes the half again straight away.
+        NRF_POWER->RAMON |= (POWER_RAMON_OFFRAM0_RAM0On << POWER_RAMON_OFFRAM0_Pos) |
+                            (POWER_RAMON_OFFRAM1_RAM1On << POWER_RAMON_OFFRAM1_Pos);
+        NRF_POWER->SYSTEMOFF = POWER_SYSTEMOFF_SYSTEMOFF_Enter;
+        while (1)
+        {
+        }
+    }
+    CRITICAL_REGION_EXIT();
+}
+#endif
+
+// 8Hz held key maintenance, keeping the reciever keystates valid, backing
+// off while nothing changes
+static void handler_maintenance(nrf_drv_rtc_int_type_t int_type)
+{
+    if (pairing_ticks)
+    {
+        pairing_tick();
+    }
+
+    // the receiver lost track of the keys, or a packet may have gone missing,
+    // so it gets them now, whether any are held or not. While pairing they
+    // would only go to the shared addresses, so wait.
+    if ((resend || resync) && !pairing_ticks)
+    {
+        resend = false;
+        resync = true;
+        keepalive_ticks = 0;
+        send_keepalive();
+    }
+
+    // report the link every so often while it is in use
+    if (++telemetry_ticks >= TELEMETRY_TICKS && link_changed)
+    {
+        telemetry_ticks = 0;
+        link_changed = false;
+        nrf_gzll_add_packet_to_tx_fifo(tx_pipe, data_payload,
+                                       packet_telemetry(data_payload, &link_stats));
+
+        // with the time in the present state brought up to date
+        ticks(maintaining, sampling);
+        nrf_gzll_add_packet_to_tx_fifo(tx_pipe, data_payload,
+                                       packet_power(data_payload, &power));
+    }
+
+    // only kept running for the keystates, which have gone now
+    if (!deb.keys && !pairing_ticks && !resync && !sampling)
+    {
+        ticks(false, false);
+    }
+
+    if (!deb.keys || ++keepalive_ticks < keepalive_gap)
+    {
+        return;
+    }
+
+    keepalive_ticks = 0;
+    keepalive_gap = (keepalive_gap * 2 > keepalive_max) ? keepalive_max : keepalive_gap * 2;
+    send_keepalive();
+}
+
+// 1000Hz debounce sampling
+static void handler_debounce(nrf_drv_rtc_int_type_t int_type)
+{
+    uint32_t sample, changed;
+
+    // the clock runs on past the counter's 24 bits
+    if (int_type == NRF_DRV_RTC_INT_OVERFLOW)
+    {
+        clock_base += RTC_COUNTER_COUNTER_Msk + 1;
+        return;
+    }
+
+#if SYSTEM_OFF_DELAY
+    // idle for SYSTEM_OFF_DELAY
+    if (int_type == NRF_DRV_RTC_INT_COMPARE0)
+    {
+        system_off();
+        return;
+    }
+#endif
+    sample = read_keys();
+
+    // the receiver's debounce profile, or back to the built in one
+    if (profile_request)
+    {
+        profile_request = false;
+        if (profile[0] == CONTROL_DEBOUNCE_OWN)
+        {
+            debounce_profile(&deb, DEBOUNCE_MODE, DEBOUNCE_PRESS, DEBOUNCE_RELEASE);
+        }
+        else
+        {
+            debounce_profile(&deb, profile[0], profile[1], profile[2]);
+        }
+    }
+
+#if SAMPLE_ON_EDGE
+    sense_arm(sample);
+#endif
+
+    changed = debounce_tick(&deb, sample);
+
+    if (changed)
+    {
+        send_events(changed);
+    }
+
+#if SAMPLE_ON_EDGE
+    // stop sampling once settled, unless a switch moved after the senses were
+    // armed, as its edge may have been lost while another pin held DETECT.
+    // A latched press goes out after its key may have been let go, and the
+    // senses are already armed for that, so it waits for the release.
+    if (!debounce_pending(&deb) && deb.keys == sample && read_keys() == sample)
+    {
+        // held keys, pairing and a resync still need the maintenance tick
+        ticks(deb.keys || pairing_ticks || resync, false);
+        settled = clock_now();
+    }
+#else
+    // looking for ACTIVITY ticks of no keys pressed, to go back to deep sleep
+    if (debounce_idle(&deb, sample))
+    {
+        ticks(pairing_ticks || resync, false);
+    }
+#endif
+}
+
+
+// Low frequency clock configuration
+static void lfclk_config(void)
+{
+    nrf_drv_clock_init();
+
+    nrf_drv_clock_lfclk_request(NULL);
+}
+
+// RTC peripheral configuration
+static void rtc_config(void)
+{
+    //Initialize RTC instance
+    nrf_drv_rtc_init(&rtc_maint, NULL, handler_maintenance);
+    nrf_drv_rtc_init(&rtc_deb, NULL, handler_debounce);
+
+    //Enable tick event & interrupt
+    nrf_drv_rtc_tick_enable(&rtc_maint,true);
+
+    //Power on RTC instance
+    //nrf_drv_rtc_enable(&rtc_maint);
+
+    // RTC1 keeps counting as the clock, its tick is only enabled to sample
+    nrf_drv_rtc_overflow_enable(&rtc_deb, true);
+    nrf_drv_rtc_enable(&rtc_deb);
+}
+
+// TIMER0 counting microseconds from waking up from System OFF
+static void wake_timer_start(void)
+{
+    NRF_TIMER0->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER0->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    NRF_TIMER0->PRESCALER = 4;
+    NRF_TIMER0->TASKS_START = 1;
+}
+
+// Microseconds since waking up, powering TIMER0 down again
+static uint32_t wake_timer_stop(void)
+{
+    uint32_t us;
+
+    NRF_TIMER0->TASKS_CAPTURE[0] = 1;
+    us = NRF_TIMER0->CC[0];
+    NRF_TIMER0->TASKS_SHUTDOWN = 1;
+
+    return us;
+}
+
+// The pipe of the stored pairing, the one bit of its pipes
+static uint8_t stored_pipe(void)
+{
+    uint8_t pipe = 0;
+
+    while (pipe < PAIRING_PIPES - 1 && !(pairing.pipes & (1UL << pipe)))
+    {
+        pipe++;
+    }
+
+    return pipe;
+}
+
+// Move the radio to the addresses and pipe in pairing, storing them if they
+// are newly received, from the main loop as erasing flash stalls the CPU
+static void radio_readdress(void)
+{
+    nrf_gzll_disable();
+    while (nrf_gzll_is_enabled())
+    {
+    }
+
+    if (paired_received)
+    {
+        pairing.pipes = 1UL << paired_pipe;
+        pairing_store(&pairing);
+        pairing_done = true;
+        paired_received = false;
+    }
+    readdress = false;
+
+    // requests still waiting would only go to the receiver's own addresses
+    nrf_gzll_flush_tx_fifo(tx_pipe);
+    tx_pipe = stored_pipe();
+
+    // another receiver, with another clock
+    delivered_valid = false;
+    synced = false;
+
+    nrf_gzll_set_base_address_0(pairing.base_address_0);
+    nrf_gzll_set_base_address_1(pairing.base_address_1);
+    nrf_gzll_enable();
+}
+
+int main()
+{
+    uint32_t reason = NRF_POWER->RESETREAS;
+    uint32_t waking = 0;
+
+    // woken from System OFF by a switch, with the .noinit RAM kept, or a cold
+    // start. The reasons pile up until written back.
+    bool resumed = reason & POWER_RESETREAS_OFF_Msk;
+    NRF_POWER->RESETREAS = reason;
+    if (resumed)
+    {
+        wake_timer_start();
+    }
+    else
+    {
+        sequence = 0;
+        wake_latency = (latency_t)LATENCY_INIT(7);
+    }
+
+    // Configure all keys as inputs with pullups, in time to see the pairing key
+    gpio_config();
+
+    // the switches that woke the half, before they can be released
+    if (resumed)
+    {
+        waking = read_keys();
+    }
+
+    // Initialize Gazell
+    nrf_gzll_init(NRF_GZLL_MODE_DEVICE);
+    
+    // Attempt sending every packet up to 100 times    
+    nrf_gzll_set_max_tx_attempts(100);
+
+    // Addressing, the receiver's own once paired, and the shared ones while
+    // asking for them, on first boot or with the pairing key held at power on
+    if (!resumed)
+    {
+        nrf_delay_ms(1);
+    }
+    if (!pairing_load(&pairing) || (!resumed && (read_keys() & (1UL << PAIRING_KEY))))
+    {
+        pairing_ticks = PAIRING_TICKS;
+        tx_pipe = PAIRING_PIPE;
+        nrf_gzll_set_base_address_0(PAIRING_BASE_ADDRESS_0);
+        nrf_gzll_set_base_address_1(PAIRING_BASE_ADDRESS_1);
+    }
+    else
+    {
+        tx_pipe = stored_pipe();
+        nrf_gzll_set_base_address_0(pairing.base_address_0);
+        nrf_gzll_set_base_address_1(pairing.base_address_1);
+    }
+
+    // Enable Gazell to start sending over the air
+    nrf_gzll_enable();
+
+    // Debounce algorithm and windows from the build configuration
+    debounce_init(&deb);
+
+    // the waking keys go out now, rather than after the crystal has started
+    // for the debounce tick, which takes a good part of a second
+    if (waking)
+    {
+        debounce_resume(&deb, waking);
+        wake_pending = true;
+        send_events(waking);
+    }
+    else if (resumed)
+    {
+        wake_timer_stop();
+        wake_latency.dropped++;
+    }
+
+    // Configure 32kHz xtal oscillator
+    lfclk_config(); 
+
+    // Configure RTC peripherals with ticks
+    rtc_config();
+
+    // Set the GPIOTE PORT event as interrupt source, and enable interrupts for GPIOTE
+    NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Msk;
+#if SAMPLE_ON_EDGE
+    // the edge takes the first sample itself, so must not preempt RTC1
+    NVIC_SetPriority(GPIOTE_IRQn, RTC1_CONFIG_IRQ_PRIORITY);
+#endif
+    NVIC_EnableIRQ(GPIOTE_IRQn);
+
+
+    // counting where the time goes from here, the maintenance tick asking to
+    // pair, and both for the waking keys, or counting down to System OFF
+    power_stats_start(&power, RTC1_CONFIG_FREQUENCY, POWER_IDLE, clock_now());
+#if SAMPLE_ON_EDGE
+    // as if long settled, so the first edge is a press
+    settled = clock_now() - ACTIVITY * CLOCK_HZ / RTC1_CONFIG_FREQUENCY - 1;
+#endif
+    if (pairing_ticks || waking)
+    {
+        ticks(true, waking);
+    }
+    else
+    {
+        off_countdown(true);
+    }
+
+    // Main loop, constantly sleep, waiting for RTC and gpio IRQs
+    while(1)
+    {
+        if (paired_received || readdress)
+        {
+            radio_readdress();
+        }
+
+        __SEV();
+        __WFE();
+        __WFE(); 
+    }
+}
+
+// This handler will be run after wakeup from system ON (GPIO wakeup)
+void GPIOTE_IRQHandler(void)
+{
+    if(NRF_GPIOTE->EVENTS_PORT)
+    {
+        // the keys at the edge, before a short tap has time to be released
+        uint32_t edge = read_keys();
+
+        //clear wakeup event
+        NRF_GPIOTE->EVENTS_PORT = 0;
+
+        pairing_retry();
+
+#if SAMPLE_ON_EDGE
+        // edges while sampling are picked up by the next tick
+        if (sampling)
+        {
+            return;
+        }
+
+        // the tick stops as soon as the debounce settles, even with keys held
+        // or just let go, so not sampling isn't idle. Only with no keys held
+        // and ACTIVITY ticks gone by is the edge a press, rather than chatter
+        // of a key just released.
+        bool idle = !deb.keys && !debounce_pending(&deb) &&
+                    clock_now() - settled > ACTIVITY * CLOCK_HZ / RTC1_CONFIG_FREQUENCY;
+
+        // restart the tick from the edge, so it has no phase error, and take
+        // the first sample now. The clock carries on through the clear, which
+        // takes an LFCLK cycle or so to show in the counter.
+        CRITICAL_REGION_ENTER();
+        uint32_t count = nrf_drv_rtc_counter_get(&rtc_deb);
+        clock_base += count;
+        nrf_drv_rtc_counter_clear(&rtc_deb);
+        while (count && nrf_drv_rtc_counter_get(&rtc_deb) >= count)
+        {
+        }
+        CRITICAL_REGION_EXIT();
+        ticks(true, true);
+
+        debounce_reset(&deb);
+        if (idle)
+        {
+            debounce_latch(&deb, edge);
+        }
+        handler_debounce(NRF_DRV_RTC_INT_TICK);
+        return;
+#endif
+
+        // from idle, every key was long released, so the edge is a press. It
+        // is latched, as the tap may be over before the debounce has seen it.
+        // While sampling, it may be a bounce of a release.
+        bool wake = !sampling;
+
+        //enable rtc interupt triggers
+        ticks(true, true);
+
+        debounce_reset(&deb);
+        if (wake)
+        {
+            debounce_latch(&deb, edge);
+        }
+    }
+}
+
+
+
+/*****************************************************************************/
+/** Gazell callback function definitions  */
+/*****************************************************************************/
+
+// Take up the receiver's settings from an ACK payload
+static void control(const uint8_t *payload)
+{
+    uint8_t flags = payload[PAYLOAD_CONTROL_FLAGS];
+
+    if (flags & CONTROL_RESEND)
+    {
+        resend = true;
+        ticks(true, sampling);
+    }
+
+    // a failed pairing keeps the LED lit over whatever the receiver asks for
+    nrf_gpio_pin_write(LED_PIN, (pairing_failed || (flags & CONTROL_LED)) ? 1 : 0);
+
+    keepalive_max = payload[PAYLOAD_KEEPALIVE] ? payload[PAYLOAD_KEEPALIVE] : KEEPALIVE_MAX;
+
+    if (payload[PAYLOAD_DEBOUNCE_MODE] != profile[0] ||
+        payload[PAYLOAD_DEBOUNCE_PRESS] != profile[1] ||
+        payload[PAYLOAD_DEBOUNCE_RELEASE] != profile[2])
+    {
+        profile[0] = payload[PAYLOAD_DEBOUNCE_MODE];
+        profile[1] = payload[PAYLOAD_DEBOUNCE_PRESS];
+        profile[2] = payload[PAYLOAD_DEBOUNCE_RELEASE];
+        profile_request = true;
+    }
+}
+
+void  nrf_gzll_device_tx_success(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info)
+{
+    uint32_t ack_payload_length = NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH;    
+    uint32_t now = clock_now();
+
+    link_stats_success(&link_stats, tx_info.num_tx_attempts, tx_info.num_channel_switches);
+    power_stats_sent(&power, tx_info.num_tx_attempts);
+    link_changed = true;
+
+    // the keys that woke the half have got through
+    if (wake_pending)
+    {
+        wake_pending = false;
+        latency_record(&wake_latency, wake_timer_stop());
+    }
+
+    if (tx_info.payload_received_in_ack)
+    {
+        // Pop packet and write first byte of the payload to the GPIO port.
+        nrf_gzll_fetch_packet_from_rx_fifo(pipe, ack_payload, &ack_payload_length);
+
+        if (ack_payload_length == CONTROL_PAYLOAD_LENGTH &&
+            ack_payload[PAYLOAD_HEADER] == PACKET_HEADER(PACKET_CONTROL))
+        {
+            control(ack_payload);
+
+            // the receiver's time in it is from the last packet arriving
+            if (delivered_valid)
+            {
+                sync_clock = delivered;
+                sync_time = ack_payload[PAYLOAD_TIME] | ack_payload[PAYLOAD_TIME + 1] << 8 |
+                            (uint32_t)ack_payload[PAYLOAD_TIME + 2] << 16;
+                synced = true;
+            }
+        }
+
+        // the receiver's addresses and the pipe given, for the main loop to
+        // move to, if the answer is for this half
+        if (pairing_ticks && !paired_received && !pairing_done &&
+            ack_payload_length == PAIRED_PAYLOAD_LENGTH &&
+            ack_payload[PAYLOAD_HEADER] == PACKET_HEADER(PACKET_PAIRED) &&
+            ack_payload[PAYLOAD_PAIRED_PIPE] != PAIRING_PIPE &&
+            ack_payload[PAYLOAD_PAIRED_PIPE] < PAIRING_PIPES)
+        {
+            uint32_t id = 0;
+
+            for (uint8_t i = 0; i < 4; i++)
+            {
+                id |= (uint32_t)ack_payload[PAYLOAD_PAIRED_ID + i] << (8 * i);
+            }
+            if (id == NRF_FICR->DEVICEID[0])
+            {
+                pairing.base_address_0 = 0;
+                pairing.base_address_1 = 0;
+                for (uint8_t i = 0; i < 4; i++)
+                {
+                    pairing.base_address_0 |= (uint32_t)ack_payload[PAYLOAD_BASE_ADDRESS_0 + i] << (8 * i);
+                    pairing.base_address_1 |= (uint32_t)ack_payload[PAYLOAD_BASE_ADDRESS_1 + i] << (8 * i);
+                }
+                paired_pipe = ack_payload[PAYLOAD_PAIRED_PIPE];
+                paired_received = true;
+            }
+        }
+    }
+
+    delivered = now;
+    delivered_valid = true;
+}
+
+// A packet ran out of attempts. Count it against the link and the battery,
+// and have the maintenance tick send the full keystates until they get through.
+void nrf_gzll_device_tx_failed(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info)
+{
+    link_stats_failed(&link_stats);
+    power_stats_sent(&power, tx_info.num_tx_attempts);
+    link_changed = true;
+
+    // the keystates go again on the next maintenance tick, until they get through
+    resync = true;
+    ticks(true, sampling);
+
+    if (wake_pending)
+    {
+        wake_pending = false;
+        wake_timer_stop();
+        wake_latency.dropped++;
+    }
+
+    // the next ACK has the time of a packet from before this one
+    delivered_valid = false;
+}
+
+// Callbacks not needed
+void nrf_gzll_host_rx_data_ready(uint32_t pipe, nrf_gzll_host_rx_info_t rx_info)
+{}
+void nrf_gzll_disabled()
+{}
+
@@ -0,0 +1,90 @@
+#include "packet.h"
+#include "mitosis_matrix.h"
+
+static void put_bitmap(uint8_t *bitmap, uint32_t wire)
+{
+    bitmap[0] = wire >> 16;
+    bitmap[1] = wire >> 8;
+    bitmap[2] = wire;
+}
+
+uint32_t packet_state(uint8_t *payload, uint32_t wire, uint8_t sequence)
+{
+    payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_STATE);
+    payload[PAYLOAD_SEQUENCE] = sequence;
+    put_bitmap(&payload[PAYLOAD_BITMAP], wire);
+
+    return PAYLOAD_EVENTS;
+}
+
+static uint32_t put_events(uint8_t *payload, uint32_t length, uint32_t wire, uint32_t moved,
+                           uint8_t *sequence)
+{
+    payload[PAYLOAD_SEQUENCE] = *sequence;
+    put_bitmap(&payload[PAYLOAD_BITMAP], wire);
+
+    for (uint8_t i = 0; i < KEY_COUNT; i++)
+    {
+        if (moved & WIRE_BIT(i))
+        {
+            payload[length++] = EVENT(i, wire & WIRE_BIT(i));
+            (*sequence)++;
+        }
+    }
+
+    return length;
+}
+
+uint32_t packet_events(uint8_t *payload, uint32_t wire, uint32_t moved, uint8_t *sequence)
+{
+    payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_EVENTS);
+
+    return put_events(payload, PAYLOAD_EVENTS, wire, moved, sequence);
+}
+
+uint32_t packet_stamped(uint8_t *payload, uint32_t wire, uint32_t moved, uint8_t *sequence,
+                        uint32_t stamp)
+{
+    payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_STAMPED);
+    payload[PAYLOAD_STAMP] = stamp;
+    payload[PAYLOAD_STAMP + 1] = stamp >> 8;
+    payload[PAYLOAD_STAMP + 2] = stamp >> 16;
+
+    return put_events(payload, PAYLOAD_STAMPED_EVENTS, wire, moved, sequence);
+}
+
+uint32_t packet_unchanged(uint8_t *payload, uint8_t sequence, uint16_t interval)
+{
+    payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_UNCHANGED);
+    payload[PAYLOAD_SEQUENCE] = sequence;
+    payload[PAYLOAD_INTERVAL] = interval;
+    payload[PAYLOAD_INTERVAL + 1] = interval >> 8;
+
+    return UNCHANGED_PAYLOAD_LENGTH;
+}
+
+uint32_t packet_pair(uint8_t *payload, uint32_t device_id, uint8_t side)
+{
+    payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_PAIR);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        payload[PAYLOAD_DEVICE_ID + i] = device_id >> (8 * i);
+    }
+    payload[PAYLOAD_SIDE] = side;
+
+    return PAIR_PAYLOAD_LENGTH;
+}
+
+uint32_t packet_telemetry(uint8_t *payload, const link_stats_t *stats)
+{
+    payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_TELEMETRY);
+
+    return PAYLOAD_LINK_STATS + link_stats_pack(&payload[PAYLOAD_LINK_STATS], stats);
+}
+
+uint32_t packet_power(uint8_t *payload, const power_stats_t *stats)
+{
+    payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_POWER);
+
+    return PAYLOAD_POWER_STATS + power_stats_pack(&payload[PAYLOAD_POWER_STATS], stats);
+}
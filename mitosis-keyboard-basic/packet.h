@@ -0,0 +1,35 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stdint.h>
+#include "mitosis_protocol.h"
+
+// Payload assembly, from keystates already in the payload bitmap layout
+// (see WIRE_BIT). Each returns the length of the payload written.
+
+// Keystates on their own, keeping held keys alive on the receiver
+uint32_t packet_state(uint8_t *payload, uint32_t wire, uint8_t sequence);
+
+// A press or release event for every moved key, along with the keystates,
+// numbering the events from *sequence onwards
+uint32_t packet_events(uint8_t *payload, uint32_t wire, uint32_t moved, uint8_t *sequence);
+
+// As packet_events, stamped with when the keys moved, in receiver timebase ticks
+uint32_t packet_stamped(uint8_t *payload, uint32_t wire, uint32_t moved, uint8_t *sequence,
+                        uint32_t stamp);
+
+// Keystates unchanged since the last packet, and the milliseconds until the
+// next keepalive
+uint32_t packet_unchanged(uint8_t *payload, uint8_t sequence, uint16_t interval);
+
+// A request for the receiver's addresses and a pipe, from the half with this
+// device ID, on a side
+uint32_t packet_pair(uint8_t *payload, uint32_t device_id, uint8_t side);
+
+// The counts of the radio link so far
+uint32_t packet_telemetry(uint8_t *payload, const link_stats_t *stats);
+
+// The time spent in each power state so far
+uint32_t packet_power(uint8_t *payload, const power_stats_t *stats);
+
+#endif
@@ -0,0 +1,83 @@
+#include <string.h>
+#include "devices.h"
+
+void devices_init(devices_t *devices, uint8_t paired, const uint32_t *ids)
+{
+    memset(devices, 0, sizeof(*devices));
+
+    for (uint8_t pipe = 0; pipe < DEVICE_PIPES; pipe++)
+    {
+        keystates_init(&devices->device[pipe].half, PIPE_SIDE(pipe));
+    }
+    devices->paired = paired & ~(1 << PAIRING_PIPE);
+    memcpy(devices->ids, ids, sizeof(devices->ids));
+}
+
+void devices_pair(devices_t *devices, uint32_t now)
+{
+    devices->pairing_start = now;
+    devices->pairing = true;
+}
+
+bool devices_pairing(devices_t *devices, uint32_t now)
+{
+    // the window closes the first time it is found to have run out
+    if (devices->pairing &&
+        ((now - devices->pairing_start) & TIMEBASE_MASK) > MS_TO_TICKS(PAIRING_WINDOW))
+    {
+        devices->pairing = false;
+    }
+
+    return devices->pairing;
+}
+
+uint8_t devices_assign(devices_t *devices, uint32_t id, uint8_t side, uint32_t now)
+{
+    uint8_t free = PAIRING_PIPE;
+
+    if (!devices_pairing(devices, now))
+    {
+        return PAIRING_PIPE;
+    }
+
+    for (uint8_t pipe = 0; pipe < DEVICE_PIPES; pipe++)
+    {
+        if (pipe == PAIRING_PIPE || PIPE_SIDE(pipe) != side)
+        {
+            continue;
+        }
+
+        // a half pairing again, or asking again before its answer got through
+        if ((devices->paired & (1 << pipe)) && devices->ids[pipe] == id)
+        {
+            return pipe;
+        }
+        if (free == PAIRING_PIPE && !(devices->paired & (1 << pipe)))
+        {
+            free = pipe;
+        }
+    }
+
+    if (free != PAIRING_PIPE)
+    {
+        devices->ids[free] = id;
+        devices->paired |= 1 << free;
+    }
+    return free;
+}
+
+bool devices_accept(devices_t *devices, uint8_t pipe)
+{
+    if (pipe < DEVICE_PIPES && (devices->paired & (1 << pipe)))
+    {
+        return true;
+    }
+
+    devices->unpaired++;
+    return false;
+}
+
+bool devices_board_paired(const devices_t *devices, uint8_t board)
+{
+    return devices->paired & (1 << BOARD_PIPE(board, SIDE_LEFT) | 1 << BOARD_PIPE(board, SIDE_RIGHT));
+}
@@ -0,0 +1,90 @@
+#ifndef DEVICES_H
+#define DEVICES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "keystates.h"
+#include "keyqueue.h"
+#include "rx_ring.h"
+#include "linkstats.h"
+#include "powerstats.h"
+#include "pairing.h"
+#include "mitosis_matrix.h"
+
+// Table of the devices on each Gazell pipe. Pipes pair up into boards, the
+// left half on the odd pipe and the right half on the even one after it, each
+// board with its own key queue and frame of keystates, so a busy board never
+// holds up another. A macro pad is a board with one half. PAIRING_PIPE is
+// kept for pairing, so the last board's right half would be on it, and only
+// its left half can be paired. Nothing here touches the hardware, so it
+// builds for any target.
+
+#define DEVICE_PIPES        PAIRING_PIPES           ///< Gazell pipes, a device on each
+#define BOARD_COUNT         (DEVICE_PIPES / 2)
+#define BOARD_SLOT(pipe)    (((pipe) + DEVICE_PIPES - 1) % DEVICE_PIPES)
+#define BOARD_OF(pipe)      (BOARD_SLOT(pipe) >> 1)
+#define PIPE_SIDE(pipe)     (BOARD_SLOT(pipe) & 1)
+#define BOARD_PIPE(board, side) ((2 * (board) + (side) + 1) % DEVICE_PIPES)
+#define BOARD_BUFFER_LENGTH (2 * MATRIX_ROWS)       ///< a data_buffer, rows of both halves
+
+#if PAIRING_PIPE != 0
+#error "boards are laid out around the pairing pipe being pipe 0"
+#endif
+
+// milliseconds the pairing window stays open
+#ifndef PAIRING_WINDOW
+#define PAIRING_WINDOW 30000
+#endif
+
+typedef struct
+{
+    half_t      half;               ///< keystates, and when last heard from
+    rx_ring_t   ring;               ///< payloads waiting for the main loop
+    uint32_t    lost;               ///< half.lost as of the last framed frame
+    link_stats_t link;              ///< radio link, as last reported by the half
+    power_stats_t power;            ///< time in each power state, as last reported by the half
+    int8_t      rssi;               ///< signal strength of the last packet, in dBm
+    int8_t      rssi_worst;         ///< weakest packet so far
+    volatile bool resend;           ///< packets were lost, ask the half for its keystates
+} device_t;
+
+typedef struct
+{
+    key_queue_t queue;                              ///< key events of both halves
+    uint8_t     data_buffer[BOARD_BUFFER_LENGTH];   ///< keystates as last framed
+    uint32_t    dropped;                            ///< queue.dropped as of the last framed frame
+} board_t;
+
+typedef struct
+{
+    device_t device[DEVICE_PIPES];
+    board_t  board[BOARD_COUNT];
+    volatile uint8_t  paired;       ///< pipes given to a half, a bit each
+    uint32_t ids[DEVICE_PIPES];     ///< device ID of the half given each pipe
+    volatile bool     pairing;      ///< the pairing window is open
+    volatile uint32_t pairing_start;
+    uint32_t unpaired;              ///< packets from pipes not paired
+} devices_t;
+
+// Start with the pipes of a stored pairing, and the halves given them
+void devices_init(devices_t *devices, uint8_t paired, const uint32_t *ids);
+
+// Open the pairing window, for halves asking to pair to be given pipes
+void devices_pair(devices_t *devices, uint32_t now);
+
+// True while the pairing window is open, closing it once it has run out
+bool devices_pairing(devices_t *devices, uint32_t now);
+
+// From the radio interrupt, the pipe for a half asking to pair: the one it was
+// given before, or else the first free one of its side. PAIRING_PIPE if the
+// window is closed or every pipe of the side is taken.
+uint8_t devices_assign(devices_t *devices, uint32_t id, uint8_t side, uint32_t now);
+
+// From the radio interrupt, true if packets from a pipe should be taken in,
+// counting those from pipes not paired
+bool devices_accept(devices_t *devices, uint8_t pipe);
+
+// True if either half of a board is paired
+bool devices_board_paired(const devices_t *devices, uint8_t board);
+
+#endif
@@ -0,0 +1,50 @@
+#include "hid.h"
+#include "keycodes.h"
+
+bool hid_press(hid_report_t *report, uint8_t keycode)
+{
+    uint8_t *slot = 0;
+
+    if (IS_MODIFIER(keycode))
+    {
+        report->modifiers |= MODIFIER_BIT(keycode);
+        return true;
+    }
+
+    for (uint8_t i = 0; i < HID_REPORT_KEYS; i++)
+    {
+        if (report->keys[i] == keycode)
+        {
+            return true;
+        }
+        if (!slot && report->keys[i] == KC_NO)
+        {
+            slot = &report->keys[i];
+        }
+    }
+
+    if (!slot)
+    {
+        return false;
+    }
+
+    *slot = keycode;
+    return true;
+}
+
+void hid_release(hid_report_t *report, uint8_t keycode)
+{
+    if (IS_MODIFIER(keycode))
+    {
+        report->modifiers &= ~MODIFIER_BIT(keycode);
+        return;
+    }
+
+    for (uint8_t i = 0; i < HID_REPORT_KEYS; i++)
+    {
+        if (report->keys[i] == keycode)
+        {
+            report->keys[i] = KC_NO;
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef HID_H
+#define HID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// USB HID boot keyboard reports, 6 key rollover. Nothing here touches the
+// hardware, so it builds for any target.
+
+#define HID_REPORT_KEYS     6
+
+typedef struct
+{
+    uint8_t  modifiers;                 ///< MODIFIER_BIT of each held modifier
+    uint8_t  reserved;
+    uint8_t  keys[HID_REPORT_KEYS];     ///< held keycodes, unused slots are KC_NO
+} hid_report_t;
+
+#define HID_REPORT_LENGTH   sizeof(hid_report_t)
+
+// Add a held keycode to the report, returning false if every slot is taken
+bool hid_press(hid_report_t *report, uint8_t keycode);
+
+// Take a keycode out of the report, whichever key put it there, so only once
+// no key held is pressed as it
+void hid_release(hid_report_t *report, uint8_t keycode);
+
+#endif
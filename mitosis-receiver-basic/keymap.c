@@ -0,0 +1,143 @@
+#include <string.h>
+#include "keymap.h"
+
+// Every layer of keymap.def, in flash
+static const uint16_t keymap_layers[LAYER_COUNT][KEYMAP_KEYS] =
+{
+#define LAYER(name, keys) keys,
+#include "keymap.def"
+#undef LAYER
+};
+
+#if LAYER_COUNT > 8
+#error "layers are kept a bit each in a byte"
+#endif
+
+void keymap_init(keymap_t *keymap)
+{
+    memset(keymap, 0, sizeof(*keymap));
+    keymap->layers = 1 << LAYER_BASE;
+}
+
+// The action of a key on the highest layer in effect that isn't transparent
+static uint16_t resolve(const keymap_t *keymap, uint8_t key)
+{
+    for (int8_t layer = LAYER_COUNT - 1; layer > 0; layer--)
+    {
+        if ((keymap->layers & (1 << layer)) && keymap_layers[layer][key] != KC_TRNS)
+        {
+            return keymap_layers[layer][key];
+        }
+    }
+
+    return keymap_layers[LAYER_BASE][key];
+}
+
+// Layers and weak modifiers follow from the held keys, so overlapping keys
+// holding the same layer or modifier can't release it for each other. Any
+// held key left out of a full report takes the first slot to free up.
+static void update(keymap_t *keymap)
+{
+    uint8_t layers = 1 << LAYER_BASE | keymap->toggled;
+    uint8_t mods = 0;
+
+    keymap->rollover = 0;
+
+    for (uint8_t key = 0; key < KEYMAP_KEYS; key++)
+    {
+        uint16_t action = keymap->active[key];
+
+        if (ACTION_KIND(action) == ACTION_MO)
+        {
+            layers |= 1 << (action & 0x07);
+        }
+        else if (ACTION_KIND(action) == ACTION_MODS)
+        {
+            mods |= action >> 8 & 0x0F;
+        }
+
+        if ((ACTION_KIND(action) == ACTION_KEY || ACTION_KIND(action) == ACTION_MODS) &&
+            (action & 0xFF) != KC_NO && !hid_press(&keymap->held, action & 0xFF))
+        {
+            keymap->rollover++;
+        }
+    }
+
+    keymap->layers = layers;
+    keymap->weak_mods = mods;
+    keymap->report = keymap->held;
+    keymap->report.modifiers |= mods;
+}
+
+// True if a held key was pressed as the keycode, as the two space keys of
+// the base layer can be, so that releasing one leaves it held for the other
+static bool keycode_held(const keymap_t *keymap, uint8_t keycode)
+{
+    for (uint8_t key = 0; key < KEYMAP_KEYS; key++)
+    {
+        uint16_t action = keymap->active[key];
+
+        if ((ACTION_KIND(action) == ACTION_KEY || ACTION_KIND(action) == ACTION_MODS) &&
+            (action & 0xFF) == keycode)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void keymap_event(keymap_t *keymap, uint8_t row, uint8_t col, bool pressed)
+{
+    uint8_t key = row * KEYMAP_COLS + col;
+    uint16_t action;
+
+    if (pressed)
+    {
+        action = resolve(keymap, key);
+        keymap->active[key] = action;
+
+        if (ACTION_KIND(action) == ACTION_TG)
+        {
+            keymap->toggled ^= 1 << (action & 0x07);
+        }
+    }
+    else
+    {
+        // release whatever the key was pressed as, whatever the layers now
+        action = keymap->active[key];
+        keymap->active[key] = KC_NO;
+
+        if ((ACTION_KIND(action) == ACTION_KEY || ACTION_KIND(action) == ACTION_MODS) &&
+            !keycode_held(keymap, action & 0xFF))
+        {
+            hid_release(&keymap->held, action & 0xFF);
+        }
+    }
+
+    update(keymap);
+}
+
+bool keymap_frame(keymap_t *keymap, const uint8_t *old_buffer, const uint8_t *data_buffer)
+{
+    hid_report_t before = keymap->report;
+
+    for (uint8_t row = 0; row < KEYMAP_ROWS; row++)
+    {
+        for (uint8_t side = 0; side < 2; side++)
+        {
+            uint8_t now = data_buffer[2 * row + side];
+            uint8_t moved = old_buffer[2 * row + side] ^ now;
+
+            for (uint8_t bit = 0; moved; bit++, moved >>= 1)
+            {
+                if (moved & 1)
+                {
+                    keymap_event(keymap, row, side * MATRIX_COLS + bit, now & (1 << bit));
+                }
+            }
+        }
+    }
+
+    return memcmp(&before, &keymap->report, sizeof(before)) != 0;
+}
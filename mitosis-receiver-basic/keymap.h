@@ -0,0 +1,87 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hid.h"
+#include "keycodes.h"
+#include "mitosis_matrix.h"
+
+// Keymap resolution on the receiver, turning matrix changes into HID reports.
+// Positions are as in QMK's Mitosis matrix, the left half in columns 0 to 4
+// and the right half in 5 to 9. The layers are declared in keymap.def and
+// compiled into tables in flash. Nothing here touches the hardware, so it
+// builds for any target.
+
+#define KEYMAP_ROWS     MATRIX_ROWS
+#define KEYMAP_COLS     (2 * MATRIX_COLS)
+#define KEYMAP_KEYS     (KEYMAP_ROWS * KEYMAP_COLS)
+
+// Actions in the keymap, 16 bits each, the kind in the top four
+#define ACTION_KEY      0x0000  ///< a keycode
+#define ACTION_MODS     0x1000  ///< a keycode, with left modifiers in bits 8 to 11
+#define ACTION_MO       0x2000  ///< a layer, while held
+#define ACTION_TG       0x3000  ///< a layer, toggled on press
+#define ACTION_KIND(a)  ((a) & 0xF000)
+
+#define KC_TRNS         0x01    ///< falls through to the next active layer down
+#define _______         KC_TRNS
+#define XXXXXXX         KC_NO
+
+#define MOD_LCTL        0x1
+#define MOD_LSFT        0x2
+#define MOD_LALT        0x4
+#define MOD_LGUI        0x8
+
+#define LCTL(kc)        (ACTION_MODS | MOD_LCTL << 8 | (kc))
+#define LSFT(kc)        (ACTION_MODS | MOD_LSFT << 8 | (kc))
+#define LALT(kc)        (ACTION_MODS | MOD_LALT << 8 | (kc))
+#define LGUI(kc)        (ACTION_MODS | MOD_LGUI << 8 | (kc))
+#define MO(layer)       (ACTION_MO | LAYER_##layer)
+#define TG(layer)       (ACTION_TG | LAYER_##layer)
+
+// The 46 keys in the order they sit on the board, into the matrix
+#define LAYOUT( \
+    k00, k01, k02, k03, k04,    k05, k06, k07, k08, k09, \
+    k10, k11, k12, k13, k14,    k15, k16, k17, k18, k19, \
+    k20, k21, k22, k23, k24,    k25, k26, k27, k28, k29, \
+         k31, k32, k33, k34,    k35, k36, k37, k38,      \
+         k41, k42, k43, k44,    k45, k46, k47, k48       \
+) { \
+    k00, k01, k02, k03, k04,    k05, k06, k07, k08, k09, \
+    k10, k11, k12, k13, k14,    k15, k16, k17, k18, k19, \
+    k20, k21, k22, k23, k24,    k25, k26, k27, k28, k29, \
+    KC_NO, k31, k32, k33, k34,  k35, k36, k37, k38, KC_NO, \
+    KC_NO, k41, k42, k43, k44,  k45, k46, k47, k48, KC_NO  \
+}
+
+// Layer names from keymap.def, LAYER_BASE first
+enum
+{
+#define LAYER(name, keys) LAYER_##name,
+#include "keymap.def"
+#undef LAYER
+    LAYER_COUNT
+};
+
+typedef struct
+{
+    uint16_t     active[KEYMAP_KEYS];   ///< action each held key was pressed as
+    uint8_t      toggled;               ///< layers toggled on, a bit each
+    uint8_t      layers;                ///< layers in effect, toggled or held
+    uint8_t      weak_mods;             ///< modifiers of held ACTION_MODS keys
+    hid_report_t held;                  ///< keycodes and modifiers held
+    hid_report_t report;                ///< report for the host, with the weak modifiers
+    uint8_t      rollover;              ///< held keys waiting for a slot in the report
+} keymap_t;
+
+void keymap_init(keymap_t *keymap);
+
+// Resolve a key press or release into the report
+void keymap_event(keymap_t *keymap, uint8_t row, uint8_t col, bool pressed);
+
+// Resolve every key that differs between two frames of data_buffer, returning
+// true if the report changed
+bool keymap_frame(keymap_t *keymap, const uint8_t *old_buffer, const uint8_t *data_buffer);
+
+#endif
@@ -0,0 +1,157 @@
+#include "keyqueue.h"
+#include "mitosis_matrix.h"
+
+// The side and key of an event, without its edge
+#define KEY_QUEUE_KEY(event) ((event) & (KEY_QUEUE_RIGHT | 0x1F))
+
+// A stamp at or before another, allowing for the timebase wrapping
+static bool stamp_before(uint32_t stamp, uint32_t other)
+{
+    return ((other - stamp) & TIMEBASE_MASK) <= TIMEBASE_MASK / 2;
+}
+
+// Insert an event behind those that happened before it, never overtaking an
+// edge of the same key
+static void key_queue_insert(key_queue_t *queue, uint8_t event, uint32_t stamp)
+{
+    uint32_t i = queue->head;
+
+    while (i != queue->tail)
+    {
+        uint32_t prev = (i - 1) % KEY_QUEUE_LENGTH;
+
+        if (stamp_before(queue->stamp[prev], stamp) ||
+            KEY_QUEUE_KEY(queue->event[prev]) == KEY_QUEUE_KEY(event))
+        {
+            break;
+        }
+        queue->event[i % KEY_QUEUE_LENGTH] = queue->event[prev];
+        queue->stamp[i % KEY_QUEUE_LENGTH] = queue->stamp[prev];
+        i--;
+    }
+
+    queue->event[i % KEY_QUEUE_LENGTH] = event;
+    queue->stamp[i % KEY_QUEUE_LENGTH] = stamp;
+    queue->head++;
+}
+
+// Unstamped events are sent as they come, stamped ones once horizon passes them
+static bool key_queue_ready(const key_queue_t *queue, uint32_t horizon)
+{
+    uint32_t tail = queue->tail % KEY_QUEUE_LENGTH;
+
+    return !(queue->event[tail] & KEY_QUEUE_STAMPED) || stamp_before(queue->stamp[tail], horizon);
+}
+
+void key_queue_push(key_queue_t *queue, const half_t *half, const uint8_t *old_keys)
+{
+    uint32_t keys = WIRE_WORD(half->keys);
+    uint32_t moved = keys ^ WIRE_WORD(old_keys);
+    uint8_t side = (half->side == SIDE_RIGHT) ? KEY_QUEUE_RIGHT : 0;
+
+    if (half->stamped)
+    {
+        side |= KEY_QUEUE_STAMPED;
+    }
+
+    for (uint8_t key = 0; moved; key++)
+    {
+        if (!(moved & WIRE_BIT(key)))
+        {
+            continue;
+        }
+        moved &= ~WIRE_BIT(key);
+
+        if (queue->head - queue->tail >= KEY_QUEUE_LENGTH)
+        {
+            if (!queue->resync)
+            {
+                queue->resync = true;
+                queue->resync_stamp = half->stamp;
+            }
+            queue->dropped++;
+            continue;
+        }
+
+        key_queue_insert(queue, side | EVENT(key, keys & WIRE_BIT(key)), half->stamp);
+    }
+}
+
+bool key_queue_pending(const key_queue_t *queue, uint32_t horizon)
+{
+    if (queue->head != queue->tail)
+    {
+        return key_queue_ready(queue, horizon);
+    }
+
+    return queue->resync;
+}
+
+bool key_queue_frame(key_queue_t *queue, const half_t *left, const half_t *right,
+                     uint8_t *data_buffer, uint32_t *stamp, uint32_t horizon)
+{
+    uint32_t touched[2] = { 0, 0 };
+    bool changed = false;
+
+    while (queue->head != queue->tail && key_queue_ready(queue, horizon))
+    {
+        uint8_t event = queue->event[queue->tail % KEY_QUEUE_LENGTH];
+        uint8_t key = EVENT_KEY(event);
+        uint8_t side = (event & KEY_QUEUE_RIGHT) ? SIDE_RIGHT : SIDE_LEFT;
+        uint8_t row = KEY_ROW(key);
+        uint8_t bit = ((side == SIDE_RIGHT) ? RIGHT_MATRIX_BIT(key) : LEFT_MATRIX_BIT(key)) >> (row * MATRIX_COLS);
+
+        // the second edge of a key goes in the next frame, as do events that
+        // happened after the first
+        if ((touched[side] & WIRE_BIT(key)) ||
+            (changed && queue->stamp[queue->tail % KEY_QUEUE_LENGTH] != *stamp))
+        {
+            break;
+        }
+        touched[side] |= WIRE_BIT(key);
+
+        if (!changed)
+        {
+            *stamp = queue->stamp[queue->tail % KEY_QUEUE_LENGTH];
+            changed = true;
+        }
+
+        if (EVENT_PRESSED(event))
+        {
+            data_buffer[2 * row + side] |= bit;
+        }
+        else
+        {
+            data_buffer[2 * row + side] &= ~bit;
+        }
+        queue->tail++;
+    }
+
+    // with every queued event sent, catch up on any that were lost
+    if (queue->head == queue->tail && queue->resync)
+    {
+        if (!changed)
+        {
+            *stamp = queue->resync_stamp;
+            changed = true;
+        }
+        queue->resync = false;
+        keystates_unpack(left, data_buffer);
+        keystates_unpack(right, data_buffer);
+    }
+
+    return changed;
+}
+
+bool key_queue_deadline(const key_queue_t *queue, uint32_t *deadline)
+{
+    uint32_t tail = queue->tail % KEY_QUEUE_LENGTH;
+
+    if (queue->head == queue->tail || !(queue->event[tail] & KEY_QUEUE_STAMPED))
+    {
+        return false;
+    }
+
+    *deadline = (queue->stamp[tail] + MS_TO_TICKS(MERGE_WINDOW) + 1) & TIMEBASE_MASK;
+    return true;
+}
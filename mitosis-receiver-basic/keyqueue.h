@@ -0,0 +1,54 @@
+#ifndef KEYQUEUE_H
+#define KEYQUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "keystates.h"
+
+// Key events of both halves, merged in the order the keys moved, waiting to
+// be sent to QMK. Frames are built from the queue an event at a time, and a
+// key that changes twice waits for the next frame, so a press and release
+// that arrive between two polls still reach QMK as two edges. Each frame only
+// carries events that happened together, so a roll across the halves reaches
+// QMK in the order it was typed.
+
+#define KEY_QUEUE_LENGTH    64      ///< power of two
+#define KEY_QUEUE_RIGHT     0x40    ///< set in events from the right half
+#define KEY_QUEUE_STAMPED   0x20    ///< set in events stamped by their half
+
+// milliseconds stamped events wait after their keys moved, while both halves
+// of the board are active, for older events of the other half still on their
+// way, 0 to send them as they arrive
+#ifndef MERGE_WINDOW
+#define MERGE_WINDOW 8
+#endif
+
+typedef struct
+{
+    uint8_t  event[KEY_QUEUE_LENGTH];   ///< EVENT(), with KEY_QUEUE_RIGHT and KEY_QUEUE_STAMPED
+    uint32_t stamp[KEY_QUEUE_LENGTH];   ///< timebase ticks the keys moved, or the event was received
+    uint32_t head, tail;
+    uint32_t dropped;                   ///< events lost to a full queue
+    bool     resync;                    ///< events were lost, rebuild the next frame from the keystates
+    uint32_t resync_stamp;              ///< when the first of them was received
+} key_queue_t;
+
+// Queue an event for every key of the half that differs from old_keys, with
+// the half's stamp, behind any queued events from before it
+void key_queue_push(key_queue_t *queue, const half_t *half, const uint8_t *old_keys);
+
+// True while there is anything ready to send to QMK, stamped events from after
+// horizon waiting to be merged
+bool key_queue_pending(const key_queue_t *queue, uint32_t horizon);
+
+// Apply the queued events ready by horizon to data_buffer in order, stopping at
+// the first key that has already changed in this frame, or an event that
+// happened later than the first. Returns true if data_buffer changed, with the
+// stamp of the oldest change in it.
+bool key_queue_frame(key_queue_t *queue, const half_t *left, const half_t *right,
+                     uint8_t *data_buffer, uint32_t *stamp, uint32_t horizon);
+
+// The time the oldest event waiting to be merged is ready, false if none are
+bool key_queue_deadline(const key_queue_t *queue, uint32_t *deadline);
+
+#endif
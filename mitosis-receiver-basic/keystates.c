@@ -0,0 +1,207 @@
+#include <string.h>
+#include "keystates.h"
+#include "mitosis_matrix.h"
+
+// Payload bitmap to QMK matrix lookup tables
+static const uint32_t left_lut[6][16] = NIBBLE_LUT_24(LEFT_WIRE_MAP);
+static const uint32_t right_lut[6][16] = NIBBLE_LUT_24(RIGHT_WIRE_MAP);
+
+void keystates_init(half_t *half, uint8_t side)
+{
+    memset(half, 0, sizeof(*half));
+    half->side = side;
+    half->timeout = MS_TO_TICKS(INACTIVE);
+}
+
+// The keystates are as last sent, in time for the next keepalive
+static void keystates_unchanged(half_t *half, const uint8_t *payload)
+{
+    int8_t gap = (int8_t)(payload[PAYLOAD_SEQUENCE] - half->sequence);
+    uint32_t interval = payload[PAYLOAD_INTERVAL] | payload[PAYLOAD_INTERVAL + 1] << 8;
+
+    // events have gone missing, so the keys are left to time out. The gap is
+    // counted the once, not again with every keepalive until the next events.
+    if (!half->synced || gap != 0)
+    {
+        if (half->synced && gap > 0)
+        {
+            half->lost += gap;
+            half->synced = false;
+        }
+        return;
+    }
+
+    half->timeout = MS_TO_TICKS(interval * KEEPALIVE_MISSES);
+}
+
+// When the events happened on the half, or when they arrived if the half
+// hasn't synced its clock, or the stamp is from after they arrived
+static void keystates_stamp(half_t *half, const uint8_t *payload, uint32_t length, uint32_t arrival)
+{
+    uint32_t stamp;
+
+    half->stamp = arrival;
+    half->stamped = false;
+
+    if (length < PAYLOAD_STAMPED_EVENTS ||
+        payload[PAYLOAD_HEADER] != PACKET_HEADER(PACKET_STAMPED))
+    {
+        return;
+    }
+
+    stamp = payload[PAYLOAD_STAMP] | payload[PAYLOAD_STAMP + 1] << 8 |
+            (uint32_t)payload[PAYLOAD_STAMP + 2] << 16;
+    if (((arrival - stamp) & TIMEBASE_MASK) <= TIMEBASE_MASK / 2)
+    {
+        half->stamp = stamp;
+        half->stamped = true;
+    }
+}
+
+void keystates_decode(half_t *half, const uint8_t *payload, uint32_t length, uint32_t arrival)
+{
+    half->received++;
+    keystates_stamp(half, payload, length, arrival);
+
+    // original firmware, the bitmap alone
+    if (length == LEGACY_PAYLOAD_LENGTH)
+    {
+        memcpy(half->keys, payload, BITMAP_LENGTH);
+        return;
+    }
+
+    if (!length || PACKET_VERSION(payload[PAYLOAD_HEADER]) != PROTOCOL_VERSION)
+    {
+        half->rejected++;
+        return;
+    }
+
+    // only keystates from here, anything else the half sends is dealt with
+    // before it gets this far
+    uint8_t first;
+
+    switch (PACKET_TYPE(payload[PAYLOAD_HEADER]))
+    {
+    case PACKET_UNCHANGED:
+        if (length != UNCHANGED_PAYLOAD_LENGTH)
+        {
+            half->rejected++;
+            return;
+        }
+        keystates_unchanged(half, payload);
+        return;
+    case PACKET_STATE:
+    case PACKET_EVENTS:
+        first = PAYLOAD_EVENTS;
+        break;
+    case PACKET_STAMPED:
+        first = PAYLOAD_STAMPED_EVENTS;
+        break;
+    default:
+        half->rejected++;
+        return;
+    }
+
+    if (length < first || length > first + KEY_COUNT)
+    {
+        half->rejected++;
+        return;
+    }
+
+    uint8_t events = length - first;
+    int8_t gap = (int8_t)(payload[PAYLOAD_SEQUENCE] - half->sequence);
+
+    if (half->synced && gap < 0 && gap >= -REORDER_WINDOW)
+    {
+        half->stale++;
+        return;
+    }
+
+    if (half->synced && gap == 0)
+    {
+        for (uint8_t i = 0; i < events; i++)
+        {
+            uint8_t event = payload[first + i];
+            uint8_t key = EVENT_KEY(event);
+
+            if (EVENT_PRESSED(event))
+            {
+                half->keys[BITMAP_BYTE(key)] |= BITMAP_BIT(key);
+            }
+            else
+            {
+                half->keys[BITMAP_BYTE(key)] &= ~BITMAP_BIT(key);
+            }
+        }
+    }
+    else if (half->synced && gap > 0)
+    {
+        half->lost += gap;
+    }
+
+    // the bitmap always agrees with in order events, and resyncs after a gap
+    memcpy(half->keys, &payload[PAYLOAD_BITMAP], BITMAP_LENGTH);
+    half->sequence = payload[PAYLOAD_SEQUENCE] + events;
+    half->synced = true;
+    half->timeout = MS_TO_TICKS(INACTIVE);
+}
+
+void keystates_unpack(const half_t *half, uint8_t *data_buffer)
+{
+    const uint32_t (*lut)[16] = (half->side == SIDE_LEFT) ? left_lut : right_lut;
+    uint32_t matrix = lut_remap(lut, WIRE_WORD(half->keys), 6);
+
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++)
+    {
+        data_buffer[2 * row + half->side] = matrix >> (row * MATRIX_COLS) & 0x1F;
+    }
+}
+
+static bool keys_held(const half_t *half)
+{
+    return half->keys[0] | half->keys[1] | half->keys[2];
+}
+
+void keystates_heard(half_t *half, uint32_t now)
+{
+    half->seen = now;
+    half->linked = true;
+}
+
+bool keystates_idle(half_t *half, uint32_t now)
+{
+    uint32_t elapsed = (now - half->seen) & TIMEBASE_MASK;
+
+    // checked again by the deadline while linked, so long before it can wrap
+    if (!half->linked || elapsed <= half->timeout)
+    {
+        return false;
+    }
+
+    half->linked = false;
+    if (!keys_held(half))
+    {
+        return false;
+    }
+
+    memset(half->keys, 0, BITMAP_LENGTH);
+    half->stamp = now;
+    half->stamped = false;
+    return true;
+}
+
+bool keystates_deadline(const half_t *half, uint32_t *deadline)
+{
+    if (!half->linked)
+    {
+        return false;
+    }
+
+    *deadline = (half->seen + half->timeout + 1) & TIMEBASE_MASK;
+    return true;
+}
+
+bool keystates_linked(const half_t *half)
+{
+    return half->linked;
+}
@@ -0,0 +1,75 @@
+#ifndef KEYSTATES_H
+#define KEYSTATES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mitosis_protocol.h"
+
+// Keystates of each half, rebuilt from their payloads and unpacked into
+// QMK's data_buffer. Nothing here touches the hardware, so it builds for any
+// target.
+
+// Timebase ticks, see mitosis_protocol.h
+#define MS_TO_TICKS(ms) ((ms) * (TIMEBASE_HZ / 8) / 125)
+
+// milliseconds for inactive keyboard, until a half advertises its keepalive interval
+#ifndef INACTIVE
+#define INACTIVE 1000
+#endif
+
+// keepalives a half may miss before its keys are released
+#ifndef KEEPALIVE_MISSES
+#define KEEPALIVE_MISSES 3
+#endif
+
+// sequence numbers this far behind the expected one are treated as stale
+// packets, anything further back as the half having restarted
+#define REORDER_WINDOW 32
+
+#define SIDE_LEFT  0
+#define SIDE_RIGHT 1
+
+typedef struct
+{
+    uint8_t  keys[BITMAP_LENGTH];   ///< keystates, in the payload bitmap layout
+    uint8_t  side;                  ///< SIDE_LEFT or SIDE_RIGHT, picking the data_buffer bytes
+    uint8_t  sequence;              ///< sequence number of the next expected event
+    bool     synced;                ///< sequence is known, from the first payload until a keepalive shows a gap
+    volatile uint32_t seen;         ///< timebase ticks when the last payload arrived
+    volatile bool linked;           ///< heard from, until the timeout goes by without a payload
+    uint32_t stamp;                 ///< timebase ticks the last events happened on the half
+    bool     stamped;               ///< stamp came from the half, rather than being the arrival
+    uint32_t timeout;               ///< ticks without a payload before releasing the keys
+    uint32_t received;              ///< payloads decoded
+    uint32_t lost;                  ///< events missing from the sequence
+    uint32_t stale;                 ///< packets arriving after newer ones
+    uint32_t rejected;              ///< payloads of an unknown version, type or length
+} half_t;
+
+void keystates_init(half_t *half, uint8_t side);
+
+// Update the keystates from a payload. Events that carry on from the last one
+// seen are applied in order, after any gap the bitmap is taken as it is. The
+// stamp is the half's, if it sent one that makes sense, otherwise arrival.
+void keystates_decode(half_t *half, const uint8_t *payload, uint32_t length, uint32_t arrival);
+
+// Unpack the keystates into the half's rows of data_buffer, the left half in
+// the even bytes, and the right half in the odd ones
+void keystates_unpack(const half_t *half, uint8_t *data_buffer);
+
+// A payload of any kind arrived from the half
+void keystates_heard(half_t *half, uint32_t now);
+
+// Once the timeout has gone by without a payload, assume the half is out of
+// range or asleep and unlink it. Returns true if that released keys, as of
+// now. A payload must not arrive between now being read and this call.
+bool keystates_idle(half_t *half, uint32_t now);
+
+// The time by which the half is unlinked, and any keys it holds released,
+// without another payload, false if it is not linked
+bool keystates_deadline(const half_t *half, uint32_t *deadline);
+
+// True if the half has been heard from within its timeout
+bool keystates_linked(const half_t *half);
+
+#endif
@@ -1,271 +1,997 @@
-
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdio.h>
-#include "app_uart.h"
-#include "nrf_drv_uart.h"
-#include "app_error.h"
-#include "nrf_delay.h"
-#include "nrf.h"
-#include "nrf_gzll.h"
-
-#define MAX_TEST_DATA_BYTES     (15U)                /**< max number of test bytes to be used for tx and rx. */
-#define UART_TX_BUF_SIZE 256                         /**< UART TX buffer size. */
-#define UART_RX_BUF_SIZE 1                           /**< UART RX buffer size. */
-
-
-#define RX_PIN_NUMBER  25
-#define TX_PIN_NUMBER  24
-#define CTS_PIN_NUMBER 23
-#define RTS_PIN_NUMBER 22
-#define HWFC           false
-
-
-// Define payload length
-#define TX_PAYLOAD_LENGTH 3 ///< 3 byte payload length
-
-// ticks for inactive keyboard
-#define INACTIVE 100000
-
-// Binary printing
-#define BYTE_TO_BINARY_PATTERN "%c%c%c%c%c"
-#define BYTE_TO_BINARY(byte)  \
-  (byte & 0x10 ? '#' : '.'), \
-  (byte & 0x08 ? '#' : '.'), \
-  (byte & 0x04 ? '#' : '.'), \
-  (byte & 0x02 ? '#' : '.'), \
-  (byte & 0x01 ? '#' : '.') 
-
-
-// Data and acknowledgement payloads
-static uint8_t data_payload_left[NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH];  ///< Placeholder for data payload received from host. 
-static uint8_t data_payload_right[NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH];  ///< Placeholder for data payload received from host. 
-static uint8_t ack_payload[TX_PAYLOAD_LENGTH];                   ///< Payload to attach to ACK sent to device.
-static uint8_t data_buffer[10];
-
-// Debug helper variables
-extern nrf_gzll_error_code_t nrf_gzll_error_code;   ///< Error code
-static bool init_ok, enable_ok, push_ok, pop_ok, packet_received_left, packet_received_right;
-uint32_t left_active = 0;
-uint32_t right_active = 0;
-uint8_t c;
-
-
-void uart_error_handle(app_uart_evt_t * p_event)
-{
-    if (p_event->evt_type == APP_UART_COMMUNICATION_ERROR)
-    {
-        APP_ERROR_HANDLER(p_event->data.error_communication);
-    }
-    else if (p_event->evt_type == APP_UART_FIFO_ERROR)
-    {
-        APP_ERROR_HANDLER(p_event->data.error_code);
-    }
-}
-
-
-int main(void)
-{
-    uint32_t err_code;
-    const app_uart_comm_params_t comm_params =
-      {
-          RX_PIN_NUMBER,
-          TX_PIN_NUMBER,
-          RTS_PIN_NUMBER,
-          CTS_PIN_NUMBER,
-          APP_UART_FLOW_CONTROL_DISABLED,
-          false,
-          UART_BAUDRATE_BAUDRATE_Baud1M
-      };
-
-    APP_UART_FIFO_INIT(&comm_params,
-                         UART_RX_BUF_SIZE,
-                         UART_TX_BUF_SIZE,
-                         uart_error_handle,
-                         APP_IRQ_PRIORITY_LOW,
-                         err_code);
-
-    APP_ERROR_CHECK(err_code);
-
-    // Initialize Gazell
-    nrf_gzll_init(NRF_GZLL_MODE_HOST);
-
-    // Addressing
-    nrf_gzll_set_base_address_0(0x01020304);
-    nrf_gzll_set_base_address_1(0x05060708);
-  
-    // Load data into TX queue
-    ack_payload[0] = 0x55;
-    nrf_gzll_add_packet_to_tx_fifo(0, data_payload_left, TX_PAYLOAD_LENGTH);
-    nrf_gzll_add_packet_to_tx_fifo(1, data_payload_left, TX_PAYLOAD_LENGTH);
-
-    // Enable Gazell to start sending over the air
-    nrf_gzll_enable();
-
-    // main loop
-    while (true)
-    {
-        // detecting received packet from interupt, and unpacking
-        if (packet_received_left)
-        {
-            packet_received_left = false;
-
-            data_buffer[0] = ((data_payload_left[0] & 1<<3) ? 1:0) << 0 |
-                             ((data_payload_left[0] & 1<<4) ? 1:0) << 1 |
-                             ((data_payload_left[0] & 1<<5) ? 1:0) << 2 |
-                             ((data_payload_left[0] & 1<<6) ? 1:0) << 3 |
-                             ((data_payload_left[0] & 1<<7) ? 1:0) << 4;
-
-            data_buffer[2] = ((data_payload_left[1] & 1<<6) ? 1:0) << 0 |
-                             ((data_payload_left[1] & 1<<7) ? 1:0) << 1 |
-                             ((data_payload_left[0] & 1<<0) ? 1:0) << 2 |
-                             ((data_payload_left[0] & 1<<1) ? 1:0) << 3 |
-                             ((data_payload_left[0] & 1<<2) ? 1:0) << 4;
-
-            data_buffer[4] = ((data_payload_left[1] & 1<<1) ? 1:0) << 0 |
-                             ((data_payload_left[1] & 1<<2) ? 1:0) << 1 |
-                             ((data_payload_left[1] & 1<<3) ? 1:0) << 2 |
-                             ((data_payload_left[1] & 1<<4) ? 1:0) << 3 |
-                             ((data_payload_left[1] & 1<<5) ? 1:0) << 4;
-
-            data_buffer[6] = ((data_payload_left[2] & 1<<5) ? 1:0) << 1 |
-                             ((data_payload_left[2] & 1<<6) ? 1:0) << 2 |
-                             ((data_payload_left[2] & 1<<7) ? 1:0) << 3 |
-                             ((data_payload_left[1] & 1<<0) ? 1:0) << 4;
-
-            data_buffer[8] = ((data_payload_left[2] & 1<<1) ? 1:0) << 1 |
-                             ((data_payload_left[2] & 1<<2) ? 1:0) << 2 |
-                             ((data_payload_left[2] & 1<<3) ? 1:0) << 3 |
-                             ((data_payload_left[2] & 1<<4) ? 1:0) << 4;
-        }
-
-        if (packet_received_right)
-        {
-            packet_received_right = false;
-            
-            data_buffer[1] = ((data_payload_right[0] & 1<<7) ? 1:0) << 0 |
-                             ((data_payload_right[0] & 1<<6) ? 1:0) << 1 |
-                             ((data_payload_right[0] & 1<<5) ? 1:0) << 2 |
-                             ((data_payload_right[0] & 1<<4) ? 1:0) << 3 |
-                             ((data_payload_right[0] & 1<<3) ? 1:0) << 4;
-
-            data_buffer[3] = ((data_payload_right[0] & 1<<2) ? 1:0) << 0 |
-                             ((data_payload_right[0] & 1<<1) ? 1:0) << 1 |
-                             ((data_payload_right[0] & 1<<0) ? 1:0) << 2 |
-                             ((data_payload_right[1] & 1<<7) ? 1:0) << 3 |
-                             ((data_payload_right[1] & 1<<6) ? 1:0) << 4;
-
-            data_buffer[5] = ((data_payload_right[1] & 1<<5) ? 1:0) << 0 |
-                             ((data_payload_right[1] & 1<<4) ? 1:0) << 1 |
-                             ((data_payload_right[1] & 1<<3) ? 1:0) << 2 |
-                             ((data_payload_right[1] & 1<<2) ? 1:0) << 3 |
-                             ((data_payload_right[1] & 1<<1) ? 1:0) << 4;
-
-            data_buffer[7] = ((data_payload_right[1] & 1<<0) ? 1:0) << 0 |
-                             ((data_payload_right[2] & 1<<7) ? 1:0) << 1 |
-                             ((data_payload_right[2] & 1<<6) ? 1:0) << 2 |
-                             ((data_payload_right[2] & 1<<5) ? 1:0) << 3;
-
-            data_buffer[9] = ((data_payload_right[2] & 1<<4) ? 1:0) << 0 |
-                             ((data_payload_right[2] & 1<<3) ? 1:0) << 1 |
-                             ((data_payload_right[2] & 1<<2) ? 1:0) << 2 |
-                             ((data_payload_right[2] & 1<<1) ? 1:0) << 3;
-        }
-
-        // checking for a poll request from QMK
-        if (app_uart_get(&c) == NRF_SUCCESS && c == 's')
-        {
-            // sending data to QMK, and an end byte
-            nrf_drv_uart_tx(data_buffer,10);
-            app_uart_put(0xE0);
-
-            // debugging help, for printing keystates to a serial console
-            /*
-            for (uint8_t i = 0; i < 10; i++)
-            {
-                app_uart_put(data_buffer[i]);
-            }
-            printf(BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN " " \
-                   BYTE_TO_BINARY_PATTERN "\r\n", \
-                   BYTE_TO_BINARY(data_buffer[0]), \
-                   BYTE_TO_BINARY(data_buffer[1]), \
-                   BYTE_TO_BINARY(data_buffer[2]), \
-                   BYTE_TO_BINARY(data_buffer[3]), \
-                   BYTE_TO_BINARY(data_buffer[4]), \
-                   BYTE_TO_BINARY(data_buffer[5]), \
-                   BYTE_TO_BINARY(data_buffer[6]), \
-                   BYTE_TO_BINARY(data_buffer[7]), \
-                   BYTE_TO_BINARY(data_buffer[8]), \
-                   BYTE_TO_BINARY(data_buffer[9]));   
-            nrf_delay_us(100);
-            */
-        }
-        // allowing UART buffers to clear
-        nrf_delay_us(10);
-        
-        // if no packets recieved from keyboards in a few seconds, assume either
-        // out of range, or sleeping due to no keys pressed, update keystates to off
-        left_active++;
-        right_active++;
-        if (left_active > INACTIVE)
-        {
-            data_buffer[0] = 0;
-            data_buffer[2] = 0;
-            data_buffer[4] = 0;
-            data_buffer[6] = 0;
-            data_buffer[8] = 0;
-            left_active = 0;
-        }
-        if (right_active > INACTIVE)
-        {
-            data_buffer[1] = 0;
-            data_buffer[3] = 0;
-            data_buffer[5] = 0;
-            data_buffer[7] = 0;
-            data_buffer[9] = 0;
-            right_active = 0;
-        }
-    }
-}
-
-
-// Callbacks not needed in this example.
-void nrf_gzll_device_tx_success(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info) {}
-void nrf_gzll_device_tx_failed(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info) {}
-void nrf_gzll_disabled() {}
-
-// If a data packet was received, identify half, and throw flag
-void nrf_gzll_host_rx_data_ready(uint32_t pipe, nrf_gzll_host_rx_info_t rx_info)
-{   
-    uint32_t data_payload_length = NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH;
-    
-    if (pipe == 0)
-    {
-        packet_received_left = true;
-        left_active = 0;
-        // Pop packet and write first byte of the payload to the GPIO port.
-        nrf_gzll_fetch_packet_from_rx_fifo(pipe, data_payload_left, &data_payload_length);
-    }
-    else if (pipe == 1)
-    {
-        packet_received_right = true;
-        right_active = 0;
-        // Pop packet and write first byte of the payload to the GPIO port.
-        nrf_gzll_fetch_packet_from_rx_fifo(pipe, data_payload_right, &data_payload_length);
-    }
-    
-    // not sure if required, I guess if enough packets are missed during blocking uart
-    nrf_gzll_flush_rx_fifo(pipe);
-
-    //load ACK payload into TX queue
-    ack_payload[0] =  0x55;
-    nrf_gzll_add_packet_to_tx_fifo(pipe, ack_payload, TX_PAYLOAD_LENGTH);
-}
\ No newline at end of file
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_drv_uart.h"
+#include "app_error.h"
+#include "nrf_delay.h"
+#include "nrf.h"
+#include "nrf_gzll.h"
+#include "nrf_drv_config.h"
+#include "nrf_drv_clock.h"
+#include "nrf_drv_rtc.h"
+#include "app_util_platform.h"
+#include "mitosis_protocol.h"
+#include "keystates.h"
+#include "latency.h"
+#include "devices.h"
+#include "txqueue.h"
+#include "framing.h"
+#include "keymap.h"
+#include "pairing.h"
+
+#if RTC1_CONFIG_FREQUENCY != TIMEBASE_HZ
+#error "the RTC1 timebase must run at TIMEBASE_HZ"
+#endif
+
+#if NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH > RX_PAYLOAD_LENGTH
+#error "received payloads must fit in an rx_ring slot"
+#endif
+
+#if FRAMED_MAX_ENCODED > TX_FRAME_LENGTH
+#error "framed frames must fit in a tx_queue slot"
+#endif
+
+#define RX_PIN_NUMBER  25
+#define TX_PIN_NUMBER  24
+#define CTS_PIN_NUMBER 23
+#define RTS_PIN_NUMBER 22
+#define HWFC           false
+
+// UART commands from QMK, and the bytes sent back
+#define CMD_POLL        's'     ///< send one frame of keystates
+#define CMD_STREAM_ON   'S'     ///< push a frame whenever keystates change
+#define CMD_STREAM_OFF  'p'     ///< return to only answering polls
+#define CMD_FRAMED_POLL 'f'     ///< send one framed frame, see framing.h
+#define CMD_FRAMED_ON   'F'     ///< push a framed frame whenever keystates change
+#define CMD_KEYCODES_ON 'K'     ///< push resolved keycodes whenever they change
+#define CMD_PAIR        'P'     ///< open the pairing window, see devices.h
+#define CMD_LINK_STATS  'D'     ///< send the radio link of every paired pipe
+#define CMD_POWER_STATS 'E'     ///< send where the time of every paired half goes
+#define CMD_LEDS        'L'     ///< then a bit for each pipe, lighting the LED of its half
+#define CMD_KEEPALIVE   'A'     ///< then the longest keepalive gap of the halves, in their ticks
+#define CMD_DEBOUNCE    'B'     ///< then the debounce algorithm, press and release windows
+#define FRAME_END       0xE0    ///< terminates every frame of keystates
+#define STREAM_ON_ACK   0xE1    ///< confirms streaming, first frame follows
+#define STREAM_OFF_ACK  0xE2    ///< confirms polling mode
+#define PAIR_ACK        0xE3    ///< confirms the pairing window is open
+
+// Command bytes from QMK, waiting for the main loop, power of two
+#define COMMAND_QUEUE_LENGTH 16
+
+
+// Data and acknowledgement payloads
+static uint8_t rx_discard[NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH];    ///< Payloads fetched with their ring full, and pairing requests.
+static uint8_t control_payload[CONTROL_PAYLOAD_LENGTH];          ///< Settings to attach to ACK sent to device.
+static uint8_t paired_payload[PAIRED_PAYLOAD_LENGTH];            ///< ACK payload answering a pairing request.
+#ifdef RECEIVER_HID
+static bool streaming = true;
+static bool framed = true;
+#else
+static bool streaming = false;
+static bool framed = false;                                      ///< streaming framed frames, not legacy ones
+#endif
+static uint8_t framed_sequence;                                  ///< sequence number of the next framed frame
+
+// Debug helper variables
+extern nrf_gzll_error_code_t nrf_gzll_error_code;   ///< Error code
+static bool init_ok, enable_ok, push_ok, pop_ok;
+
+// Keystates of the device on each pipe, received payloads queued for the
+// main loop, and the changes of each board waiting to be sent to QMK
+static devices_t devices;
+
+// The receiver's own addresses, and the pipes paired with them as stored
+static pairing_t pairing;
+static bool radio_pairing;              ///< PAIRING_PIPE is on the shared pairing address
+
+// Free running timebase, waking the main loop for the devices' deadlines
+const nrf_drv_rtc_t rtc_time = NRF_DRV_RTC_INSTANCE(1);
+
+// Latency from a payload being received to QMK being sent the frame with its
+// change, in timebase ticks
+static latency_t frame_latency = LATENCY_INIT(5);
+
+// Latency from keys moving on a half to their payload arriving, radio retries
+// included, in timebase ticks, from the halves' stamped events
+static latency_t radio_latency = LATENCY_INIT(5);
+
+// Frames for QMK, sent from the UART interrupt, and the command bytes it receives
+static tx_queue_t tx_queue;
+static volatile bool tx_busy;           ///< a frame is being sent
+static volatile bool frames_waiting;    ///< key events are queued for frames not yet built
+static uint8_t rx_byte;
+static uint8_t command_queue[COMMAND_QUEUE_LENGTH];
+static volatile uint32_t command_head, command_tail;
+static uint8_t command_pending;         ///< command waiting for its argument bytes
+static uint8_t command_args[3];
+static uint8_t command_argc;
+
+// Settings for the halves, sent in every ACK payload
+static volatile uint8_t leds;           ///< a bit for each pipe with its LED lit
+static volatile uint8_t keepalive_max;  ///< longest keepalive gap, 0 for the halves' own
+static volatile uint8_t debounce_setting[3] = { CONTROL_DEBOUNCE_OWN };
+static uint32_t command_overrun;        ///< command bytes lost with the queue full
+
+
+// Start sending the next queued frame, from the UART interrupt, or with it masked
+static void uart_send_next(void)
+{
+    tx_frame_t *frame = tx_queue_peek(&tx_queue);
+
+    if (frame)
+    {
+        tx_busy = true;
+        nrf_drv_uart_tx(frame->data, frame->length);
+    }
+    else
+    {
+        tx_busy = false;
+        if (frames_waiting)
+        {
+            tx_queue.underruns++;
+        }
+    }
+}
+
+// Sent frames are freed and the next started, received bytes are queued as
+// commands for the main loop
+static void uart_event_handler(nrf_drv_uart_event_t * p_event, void * p_context)
+{
+    if (p_event->type == NRF_DRV_UART_EVT_TX_DONE)
+    {
+        tx_queue_pop(&tx_queue);
+        uart_send_next();
+        return;
+    }
+
+    if (p_event->type == NRF_DRV_UART_EVT_RX_DONE)
+    {
+        if (command_head - command_tail < COMMAND_QUEUE_LENGTH)
+        {
+            command_queue[command_head % COMMAND_QUEUE_LENGTH] = rx_byte;
+            command_head++;
+        }
+        else
+        {
+            command_overrun++;
+        }
+    }
+
+    // a byte with an error is dropped, either way wait for the next
+    nrf_drv_uart_rx(&rx_byte, 1);
+}
+
+// Get the transmitter going, if it is idle
+static void uart_kick(void)
+{
+    NVIC_DisableIRQ(UART0_IRQn);
+    if (!tx_busy)
+    {
+        uart_send_next();
+    }
+    NVIC_EnableIRQ(UART0_IRQn);
+}
+
+// Queue a frame for QMK, the UART sends it in the background
+static void uart_send(const uint8_t *data, uint32_t length)
+{
+    if (tx_queue_push(&tx_queue, data, length))
+    {
+        uart_kick();
+    }
+}
+
+static void uart_config(void)
+{
+    nrf_drv_uart_config_t config = NRF_DRV_UART_DEFAULT_CONFIG;
+
+    config.pseltxd = TX_PIN_NUMBER;
+    config.pselrxd = RX_PIN_NUMBER;
+    config.pselcts = CTS_PIN_NUMBER;
+    config.pselrts = RTS_PIN_NUMBER;
+    config.baudrate = NRF_UART_BAUDRATE_1000000;
+
+    APP_ERROR_CHECK(nrf_drv_uart_init(&config, uart_event_handler));
+    nrf_drv_uart_rx(&rx_byte, 1);
+}
+
+
+// Apply every payload queued for a device, in the order they arrived,
+// queueing the key events on its board
+static void receive(uint8_t pipe)
+{
+    device_t *device = &devices.device[pipe];
+    uint8_t old_keys[BITMAP_LENGTH];
+    uint32_t lost;
+    rx_slot_t *slot;
+
+    while ((slot = rx_ring_peek(&device->ring)) != 0)
+    {
+        // link reports are kept for the diagnostic command
+        if (slot->length == TELEMETRY_PAYLOAD_LENGTH &&
+            slot->payload[PAYLOAD_HEADER] == PACKET_HEADER(PACKET_TELEMETRY))
+        {
+            link_stats_unpack(&device->link, &slot->payload[PAYLOAD_LINK_STATS]);
+            rx_ring_pop(&device->ring);
+            continue;
+        }
+        if (slot->length == POWER_PAYLOAD_LENGTH &&
+            slot->payload[PAYLOAD_HEADER] == PACKET_HEADER(PACKET_POWER))
+        {
+            power_stats_unpack(&device->power, &slot->payload[PAYLOAD_POWER_STATS]);
+            rx_ring_pop(&device->ring);
+            continue;
+        }
+
+        memcpy(old_keys, device->half.keys, BITMAP_LENGTH);
+        lost = device->half.lost;
+        keystates_decode(&device->half, slot->payload, slot->length, slot->stamp);
+        if (device->half.stamped)
+        {
+            latency_record(&radio_latency, (slot->stamp - device->half.stamp) & TIMEBASE_MASK);
+        }
+
+        // ask for the keystates straight away, rather than waiting for them
+        if (device->half.lost != lost)
+        {
+            device->resend = true;
+        }
+
+        key_queue_push(&devices.board[BOARD_OF(pipe)].queue, &device->half, old_keys);
+        rx_ring_pop(&device->ring);
+    }
+}
+
+// Release the keys of a device that has gone quiet
+static void expire(uint8_t pipe)
+{
+    device_t *device = &devices.device[pipe];
+    uint8_t old_keys[BITMAP_LENGTH];
+    bool idle;
+
+    // with the radio held off, so a payload can't arrive after the time
+    // it is measured against was read
+    memcpy(old_keys, device->half.keys, BITMAP_LENGTH);
+    CRITICAL_REGION_ENTER();
+    idle = keystates_idle(&device->half, nrf_drv_rtc_counter_get(&rtc_time));
+    CRITICAL_REGION_EXIT();
+
+    if (idle)
+    {
+        key_queue_push(&devices.board[BOARD_OF(pipe)].queue, &device->half, old_keys);
+    }
+}
+
+// Stamped events wait out the merge window while both halves of a board are
+// active, as older events of the other half may still be on their way
+static uint32_t board_horizon(uint8_t board, uint32_t now)
+{
+    if (keystates_linked(&devices.device[BOARD_PIPE(board, SIDE_LEFT)].half) &&
+        keystates_linked(&devices.device[BOARD_PIPE(board, SIDE_RIGHT)].half))
+    {
+        return (now - MS_TO_TICKS(MERGE_WINDOW)) & TIMEBASE_MASK;
+    }
+
+    return now;
+}
+
+// True while a board has changes ready to send
+static bool board_pending(uint8_t board, uint32_t now)
+{
+    return key_queue_pending(&devices.board[board].queue, board_horizon(board, now));
+}
+
+// Apply the next frame of changes of a board to its data_buffer
+static bool board_frame(uint8_t board)
+{
+    uint32_t now = nrf_drv_rtc_counter_get(&rtc_time);
+    uint32_t stamp;
+
+    if (!key_queue_frame(&devices.board[board].queue,
+                         &devices.device[BOARD_PIPE(board, SIDE_LEFT)].half,
+                         &devices.device[BOARD_PIPE(board, SIDE_RIGHT)].half,
+                         devices.board[board].data_buffer, &stamp, board_horizon(board, now)))
+    {
+        return false;
+    }
+
+    latency_record(&frame_latency, (now - stamp) & TIMEBASE_MASK);
+    return true;
+}
+
+// Send the next frame of keystates to QMK, followed by the end byte
+static void send_frame(void)
+{
+    uint8_t frame[BOARD_BUFFER_LENGTH + 1];
+
+    board_frame(0);
+
+    memcpy(frame, devices.board[0].data_buffer, BOARD_BUFFER_LENGTH);
+    frame[BOARD_BUFFER_LENGTH] = FRAME_END;
+    uart_send(frame, sizeof(frame));
+}
+
+// Status bits for the next framed frame of a board, reporting losses since
+// its last one
+static uint8_t framed_status(uint8_t board)
+{
+    device_t *left = &devices.device[BOARD_PIPE(board, SIDE_LEFT)];
+    device_t *right = &devices.device[BOARD_PIPE(board, SIDE_RIGHT)];
+    board_t *frames = &devices.board[board];
+    uint8_t status = 0;
+
+    if (keystates_linked(&left->half))
+    {
+        status |= FRAMED_STATUS_LEFT;
+    }
+    if (keystates_linked(&right->half))
+    {
+        status |= FRAMED_STATUS_RIGHT;
+    }
+    if (left->half.lost != left->lost)
+    {
+        status |= FRAMED_STATUS_LEFT_LOST;
+        left->lost = left->half.lost;
+    }
+    if (right->half.lost != right->lost)
+    {
+        status |= FRAMED_STATUS_RIGHT_LOST;
+        right->lost = right->half.lost;
+    }
+    if (frames->queue.dropped != frames->dropped)
+    {
+        status |= FRAMED_STATUS_RESYNC;
+        frames->dropped = frames->queue.dropped;
+    }
+
+    return status;
+}
+
+// Send the next frame of keystates of a board to QMK as a checked, numbered
+// frame, the original board as plain keystates, others led by their number
+static void send_framed(uint8_t board)
+{
+    uint8_t body[1 + BOARD_BUFFER_LENGTH];
+    uint8_t frame[FRAMED_MAX_ENCODED];
+    uint32_t length;
+
+    board_frame(board);
+
+    if (board == 0)
+    {
+        length = framing_encode(frame, FRAMED_KEYS, framed_sequence++, framed_status(0),
+                                devices.board[0].data_buffer, BOARD_BUFFER_LENGTH);
+    }
+    else
+    {
+        body[0] = board;
+        memcpy(&body[1], devices.board[board].data_buffer, BOARD_BUFFER_LENGTH);
+        length = framing_encode(frame, FRAMED_BOARD_KEYS, framed_sequence++, framed_status(board),
+                                body, sizeof(body));
+    }
+    uart_send(frame, length);
+}
+
+// Keymap resolution, for the USB bridge or QMK's keycode mode
+static keymap_t keymap;
+#ifdef RECEIVER_HID
+static bool resolving = true;
+#else
+static bool resolving = false;
+#endif
+
+// Send the resolved keys, as a boot report for the USB bridge, or with the
+// active layers for QMK
+static void send_resolved(void)
+{
+    uint8_t body[HID_REPORT_LENGTH + 1];
+    uint8_t frame[FRAMED_MAX_ENCODED];
+    uint32_t length;
+
+    memcpy(body, &keymap.report, HID_REPORT_LENGTH);
+#ifdef RECEIVER_HID
+    length = framing_encode(frame, FRAMED_HID_REPORT, framed_sequence++, framed_status(0),
+                            body, HID_REPORT_LENGTH);
+#else
+    body[HID_REPORT_LENGTH] = keymap.layers;
+    length = framing_encode(frame, FRAMED_KEYCODES, framed_sequence++, framed_status(0),
+                            body, sizeof(body));
+#endif
+    uart_send(frame, length);
+}
+
+// Resolve the next frame of changes of the original board through the
+// keymap, sending them if the keys changed
+static void send_report(void)
+{
+    uint8_t old_buffer[BOARD_BUFFER_LENGTH];
+
+    memcpy(old_buffer, devices.board[0].data_buffer, BOARD_BUFFER_LENGTH);
+    if (board_frame(0) && keymap_frame(&keymap, old_buffer, devices.board[0].data_buffer))
+    {
+        send_resolved();
+    }
+}
+
+// Boards other than the original only go out in framed frames, and never
+// to the USB bridge
+static bool board_streamed(uint8_t board)
+{
+#ifdef RECEIVER_HID
+    return board == 0;
+#else
+    return board == 0 || (framed && devices_board_paired(&devices, board));
+#endif
+}
+
+// Send the next frame of changes of a board, in whichever form QMK asked for
+static void send_next(uint8_t board)
+{
+    if (board == 0 && resolving)
+    {
+        send_report();
+    }
+    else if (framed)
+    {
+        send_framed(board);
+    }
+    else
+    {
+        send_frame();
+    }
+}
+
+// True while a streamed board has changes waiting
+static bool boards_pending(uint32_t now)
+{
+    for (uint8_t board = 0; board < BOARD_COUNT; board++)
+    {
+        if (board_streamed(board) && board_pending(board, now))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Little endian, stopping at the largest count that fits
+static void put_count(uint8_t *out, uint32_t count)
+{
+    if (count > 0xFFFF)
+    {
+        count = 0xFFFF;
+    }
+    out[0] = count;
+    out[1] = count >> 8;
+}
+
+// Send the radio link of every paired pipe, a framed frame each:
+//   [0]      pipe
+//   [1]      signal strength of the last packet, in dBm
+//   [2]      weakest packet so far, in dBm
+//   [3..4]   payloads received
+//   [5..6]   key events lost
+//   [7..8]   payloads dropped with the receive ring full
+//   [9..34]  the half's own counts, link_stats_pack()
+static void send_link_stats(void)
+{
+    uint8_t body[9 + LINK_STATS_LENGTH];
+    uint8_t frame[FRAMED_MAX_ENCODED];
+    uint8_t status;
+    uint32_t length;
+
+    for (uint8_t pipe = 0; pipe < DEVICE_PIPES; pipe++)
+    {
+        device_t *device = &devices.device[pipe];
+
+        if (!(devices.paired & (1 << pipe)))
+        {
+            continue;
+        }
+
+        body[0] = pipe;
+        body[1] = device->rssi;
+        body[2] = device->rssi_worst;
+        put_count(&body[3], device->half.received);
+        put_count(&body[5], device->half.lost);
+        put_count(&body[7], device->ring.overrun);
+        link_stats_pack(&body[9], &device->link);
+
+        // only whether the half is heard from, losses are left for the key frames
+        status = 0;
+        if (keystates_linked(&device->half))
+        {
+            status = (PIPE_SIDE(pipe) == SIDE_RIGHT) ? FRAMED_STATUS_RIGHT : FRAMED_STATUS_LEFT;
+        }
+
+        length = framing_encode(frame, FRAMED_LINK_STATS, framed_sequence++,
+                                status, body, sizeof(body));
+        uart_send(frame, length);
+    }
+}
+
+// Send where the time of every paired half goes, a framed frame each, with
+// the pipe, then the half's counts as power_stats_pack() left them
+static void send_power_stats(void)
+{
+    uint8_t body[1 + POWER_STATS_LENGTH];
+    uint8_t frame[FRAMED_MAX_ENCODED];
+    uint32_t length;
+
+    for (uint8_t pipe = 0; pipe < DEVICE_PIPES; pipe++)
+    {
+        if (!(devices.paired & (1 << pipe)))
+        {
+            continue;
+        }
+
+        body[0] = pipe;
+        power_stats_pack(&body[1], &devices.device[pipe].power);
+        length = framing_encode(frame, FRAMED_POWER_STATS, framed_sequence++,
+                                0, body, sizeof(body));
+        uart_send(frame, length);
+    }
+}
+
+// Send a single byte reply to QMK
+static void send_byte(uint8_t byte)
+{
+    uart_send(&byte, 1);
+}
+
+// A debounce window from QMK, within what the halves can count
+static uint8_t debounce_window(uint8_t ticks)
+{
+    if (ticks < 1)
+    {
+        return 1;
+    }
+    return (ticks > CONTROL_DEBOUNCE_MAX) ? CONTROL_DEBOUNCE_MAX : ticks;
+}
+
+// Settings for the halves, taking effect with the next ACK to each
+static void handle_setting(uint8_t command, const uint8_t *args)
+{
+    if (command == CMD_LEDS)
+    {
+        leds = args[0];
+    }
+    else if (command == CMD_KEEPALIVE)
+    {
+        keepalive_max = args[0];
+    }
+    else if (command == CMD_DEBOUNCE && (args[0] < CONTROL_DEBOUNCE_MODES || args[0] == CONTROL_DEBOUNCE_OWN))
+    {
+        debounce_setting[1] = debounce_window(args[1]);
+        debounce_setting[2] = debounce_window(args[2]);
+        debounce_setting[0] = args[0];
+    }
+}
+
+// Argument bytes following a command
+static uint8_t command_arguments(uint8_t command)
+{
+    if (command == CMD_LEDS || command == CMD_KEEPALIVE)
+    {
+        return 1;
+    }
+    if (command == CMD_DEBOUNCE)
+    {
+        return 3;
+    }
+
+    return 0;
+}
+
+// Answer a poll request or mode change from QMK
+static void handle_command(uint8_t command)
+{
+    if (command == CMD_PAIR)
+    {
+        devices_pair(&devices, nrf_drv_rtc_counter_get(&rtc_time));
+#ifndef RECEIVER_HID
+        send_byte(PAIR_ACK);
+#endif
+        return;
+    }
+#ifdef RECEIVER_HID
+    // the USB bridge can only open pairing
+    return;
+#endif
+
+    // diagnostics leave the keystates, and the mode, as they are
+    if (command == CMD_LINK_STATS)
+    {
+        send_link_stats();
+        return;
+    }
+    if (command == CMD_POWER_STATS)
+    {
+        send_power_stats();
+        return;
+    }
+
+    // other commands consume key changes without the keymap, so it starts
+    // over from the current keystates when resolving again
+    resolving = (command == CMD_KEYCODES_ON);
+
+    if (command == CMD_POLL)
+    {
+        // sending data to QMK, and an end byte
+        send_frame();
+    }
+    else if (command == CMD_STREAM_ON)
+    {
+        // acknowledge, then bring QMK up to date straight away
+        streaming = true;
+        framed = false;
+        send_byte(STREAM_ON_ACK);
+        send_frame();
+    }
+    else if (command == CMD_STREAM_OFF)
+    {
+        streaming = false;
+        send_byte(STREAM_OFF_ACK);
+    }
+    else if (command == CMD_FRAMED_POLL)
+    {
+        send_framed(0);
+    }
+    else if (command == CMD_FRAMED_ON)
+    {
+        // the first frame is the acknowledgement
+        streaming = true;
+        framed = true;
+        send_framed(0);
+    }
+    else if (command == CMD_KEYCODES_ON)
+    {
+        // the first frame, with the keys already held, is the acknowledgement
+        uint8_t released[BOARD_BUFFER_LENGTH] = {0};
+
+        streaming = true;
+        framed = true;
+        keymap_init(&keymap);
+        keymap_frame(&keymap, released, devices.board[0].data_buffer);
+        send_resolved();
+    }
+}
+
+// Compare interrupts only wake the main loop
+static void handler_time(nrf_drv_rtc_int_type_t int_type)
+{
+}
+
+// Low frequency clock, and the timebase running from it
+static void timebase_config(void)
+{
+    nrf_drv_clock_init();
+    nrf_drv_clock_lfclk_request(NULL);
+
+    nrf_drv_rtc_init(&rtc_time, NULL, handler_time);
+    nrf_drv_rtc_enable(&rtc_time);
+}
+
+// Base addresses for the radio, which must be disabled. Only PAIRING_PIPE,
+// alone on base address 0, moves to the shared address, and the pipes given
+// to halves stay on the receiver's own base address 1.
+static void radio_set_addresses(bool shared)
+{
+    nrf_gzll_set_base_address_0(shared ? PAIRING_BASE_ADDRESS_0 : pairing.base_address_0);
+    nrf_gzll_set_base_address_1(pairing.base_address_1);
+    radio_pairing = shared;
+}
+
+// Listen for pairing requests while the pairing window is open, and store the
+// pipes given out once it closes
+static void radio_addresses(bool shared)
+{
+    nrf_gzll_disable();
+    while (nrf_gzll_is_enabled())
+    {
+    }
+
+    if (!shared && pairing.pipes != devices.paired)
+    {
+        pairing.pipes = devices.paired;
+        memcpy(pairing.ids, devices.ids, sizeof(pairing.ids));
+        pairing_store(&pairing);
+    }
+    radio_set_addresses(shared);
+
+    nrf_gzll_enable();
+}
+
+// Set the timebase to wake the main loop at the earliest deadline of a device
+// with keys held, or of events being merged
+static void timebase_wake(uint32_t now)
+{
+    uint32_t deadline, wait = TIMEBASE_MASK;
+
+    for (uint8_t pipe = 0; pipe < DEVICE_PIPES; pipe++)
+    {
+        if (keystates_deadline(&devices.device[pipe].half, &deadline) &&
+            ((deadline - now) & TIMEBASE_MASK) < wait)
+        {
+            wait = (deadline - now) & TIMEBASE_MASK;
+        }
+    }
+
+    // and events waiting to be merged
+    for (uint8_t board = 0; board < BOARD_COUNT; board++)
+    {
+        if (key_queue_deadline(&devices.board[board].queue, &deadline) &&
+            ((deadline - now) & TIMEBASE_MASK) <= TIMEBASE_MASK / 2 &&
+            ((deadline - now) & TIMEBASE_MASK) < wait)
+        {
+            wait = (deadline - now) & TIMEBASE_MASK;
+        }
+    }
+
+    // and the end of the pairing window, to move the radio back
+    deadline = (devices.pairing_start + MS_TO_TICKS(PAIRING_WINDOW) + 1) & TIMEBASE_MASK;
+    if (devices.pairing && ((deadline - now) & TIMEBASE_MASK) < wait)
+    {
+        wait = (deadline - now) & TIMEBASE_MASK;
+    }
+
+    if (wait == TIMEBASE_MASK)
+    {
+        nrf_drv_rtc_cc_disable(&rtc_time, 0);
+        return;
+    }
+
+    // the compare needs to be a couple of ticks out to be sure of firing, and
+    // a passed deadline wraps around to a huge wait
+    if (wait < 2 || wait > TIMEBASE_MASK / 2)
+    {
+        wait = 2;
+    }
+    nrf_drv_rtc_cc_set(&rtc_time, 0, (now + wait) & TIMEBASE_MASK, true);
+}
+
+// Load the settings for a half into the ACK payload of its next packet, from
+// the Gazell interrupt, or before Gazell is enabled
+static void load_control(uint8_t pipe, uint32_t now)
+{
+    device_t *device = &devices.device[pipe % DEVICE_PIPES];
+
+    control_payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_CONTROL);
+    control_payload[PAYLOAD_CONTROL_FLAGS] = 0;
+    if (device->resend)
+    {
+        device->resend = false;
+        control_payload[PAYLOAD_CONTROL_FLAGS] |= CONTROL_RESEND;
+    }
+    if (leds & (1 << pipe))
+    {
+        control_payload[PAYLOAD_CONTROL_FLAGS] |= CONTROL_LED;
+    }
+    control_payload[PAYLOAD_KEEPALIVE] = keepalive_max;
+    control_payload[PAYLOAD_DEBOUNCE_MODE] = debounce_setting[0];
+    control_payload[PAYLOAD_DEBOUNCE_PRESS] = debounce_setting[1];
+    control_payload[PAYLOAD_DEBOUNCE_RELEASE] = debounce_setting[2];
+    control_payload[PAYLOAD_TIME] = now;
+    control_payload[PAYLOAD_TIME + 1] = now >> 8;
+    control_payload[PAYLOAD_TIME + 2] = now >> 16;
+
+    nrf_gzll_add_packet_to_tx_fifo(pipe, control_payload, CONTROL_PAYLOAD_LENGTH);
+}
+
+
+int main(void)
+{
+    bool first_boot = false;
+
+    uart_config();
+
+    // the receiver's own addresses, derived from its device ID the first
+    // time, when pairing opens straight away for the halves to find them
+    if (!pairing_load(&pairing))
+    {
+        pairing_derive(&pairing, NRF_FICR->DEVICEID[0], NRF_FICR->DEVICEID[1]);
+        pairing.pipes = 0;
+        memset(pairing.ids, 0, sizeof(pairing.ids));
+        pairing_store(&pairing);
+        first_boot = true;
+    }
+    paired_payload[PAYLOAD_HEADER] = PACKET_HEADER(PACKET_PAIRED);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        paired_payload[PAYLOAD_BASE_ADDRESS_0 + i] = pairing.base_address_0 >> (8 * i);
+        paired_payload[PAYLOAD_BASE_ADDRESS_1 + i] = pairing.base_address_1 >> (8 * i);
+    }
+
+    keymap_init(&keymap);
+
+    timebase_config();
+    devices_init(&devices, pairing.pipes, pairing.ids);
+    if (first_boot)
+    {
+        devices_pair(&devices, nrf_drv_rtc_counter_get(&rtc_time));
+    }
+
+    // Initialize Gazell
+    nrf_gzll_init(NRF_GZLL_MODE_HOST);
+
+    // Addressing
+    radio_set_addresses(devices.pairing);
+  
+    // Load data into TX queue
+    for (uint8_t pipe = 0; pipe < DEVICE_PIPES; pipe++)
+    {
+        load_control(pipe, nrf_drv_rtc_counter_get(&rtc_time));
+    }
+
+    // Enable Gazell to start sending over the air
+    nrf_gzll_enable();
+
+    // main loop, sleeping between packets, UART bytes and deadlines
+    while (true)
+    {
+        uint32_t now;
+        bool sent;
+
+        // unpacking packets queued by the interupt
+        for (uint8_t pipe = 0; pipe < DEVICE_PIPES; pipe++)
+        {
+            receive(pipe);
+        }
+
+        // checking for poll requests, mode changes and pairing from QMK
+        while (command_tail != command_head)
+        {
+            uint8_t byte = command_queue[command_tail % COMMAND_QUEUE_LENGTH];
+
+            if (command_pending)
+            {
+                command_args[command_argc++] = byte;
+                if (command_argc == command_arguments(command_pending))
+                {
+                    handle_setting(command_pending, command_args);
+                    command_pending = 0;
+                }
+            }
+            else if (command_arguments(byte))
+            {
+                command_pending = byte;
+                command_argc = 0;
+            }
+            else
+            {
+                handle_command(byte);
+            }
+            command_tail++;
+        }
+
+        // if no packets recieved from keyboards in a few seconds, assume either
+        // out of range, or sleeping due to no keys pressed, update keystates to off
+        for (uint8_t pipe = 0; pipe < DEVICE_PIPES; pipe++)
+        {
+            expire(pipe);
+        }
+        now = nrf_drv_rtc_counter_get(&rtc_time);
+
+        // the radio follows the pairing window
+        if (devices_pairing(&devices, now) != radio_pairing)
+        {
+            radio_addresses(!radio_pairing);
+        }
+
+        // when streaming, push keystates as soon as they change rather than
+        // waiting for the next poll, a frame for each edge of the same key,
+        // as fast as the UART takes them, taking a frame from each board in
+        // turn so a busy board can't hold up the others
+        do
+        {
+            sent = false;
+            for (uint8_t board = 0; board < BOARD_COUNT; board++)
+            {
+                if (streaming && board_streamed(board) &&
+                    board_pending(board, now) &&
+                    tx_queue_depth(&tx_queue) < TX_QUEUE_SLOTS)
+                {
+                    send_next(board);
+                    sent = true;
+                }
+            }
+        } while (sent);
+        frames_waiting = streaming && boards_pending(now);
+
+        // sleep until the next interrupt, an event from one that has already
+        // run since the last pass falls straight through
+        timebase_wake(now);
+        __WFE();
+        __SEV();
+        __WFE();
+    }
+}
+
+
+// Callbacks not needed in this example.
+void nrf_gzll_device_tx_success(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info) {}
+void nrf_gzll_device_tx_failed(uint32_t pipe, nrf_gzll_device_tx_info_t tx_info) {}
+void nrf_gzll_disabled() {}
+
+// If a data packet was received from a paired device, queue it for the main
+// loop. Halves asking to pair are given a pipe, answered on the ACK of their
+// next packet.
+void nrf_gzll_host_rx_data_ready(uint32_t pipe, nrf_gzll_host_rx_info_t rx_info)
+{   
+    uint32_t data_payload_length = NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH;
+    uint32_t now = nrf_drv_rtc_counter_get(&rtc_time);
+    device_t *device = &devices.device[pipe % DEVICE_PIPES];
+    uint8_t paired_pipe = PAIRING_PIPE;
+    uint32_t id = 0;
+    rx_slot_t *slot;
+
+    if (pipe == PAIRING_PIPE)
+    {
+        // only pairing requests are taken in on it
+        while (nrf_gzll_get_rx_fifo_packet_count(pipe) > 0)
+        {
+            data_payload_length = NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH;
+            nrf_gzll_fetch_packet_from_rx_fifo(pipe, rx_discard, &data_payload_length);
+            if (data_payload_length == PAIR_PAYLOAD_LENGTH &&
+                rx_discard[PAYLOAD_HEADER] == PACKET_HEADER(PACKET_PAIR) &&
+                rx_discard[PAYLOAD_SIDE] <= SIDE_RIGHT)
+            {
+                id = 0;
+                for (uint8_t i = 0; i < 4; i++)
+                {
+                    id |= (uint32_t)rx_discard[PAYLOAD_DEVICE_ID + i] << (8 * i);
+                }
+                paired_pipe = devices_assign(&devices, id, rx_discard[PAYLOAD_SIDE], now);
+            }
+        }
+    }
+    else if (devices_accept(&devices, pipe))
+    {
+        keystates_heard(&device->half, now);
+        device->rssi = rx_info.rssi;
+        if (device->rssi < device->rssi_worst)
+        {
+            device->rssi_worst = device->rssi;
+        }
+
+        // Pop every queued packet into the next free slot, or count it lost
+        // if there are none
+        while (nrf_gzll_get_rx_fifo_packet_count(pipe) > 0)
+        {
+            data_payload_length = NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH;
+            slot = rx_ring_claim(&device->ring);
+            if (slot)
+            {
+                nrf_gzll_fetch_packet_from_rx_fifo(pipe, slot->payload, &data_payload_length);
+                slot->length = data_payload_length;
+                slot->stamp = now;
+                rx_ring_push(&device->ring);
+            }
+            else
+            {
+                nrf_gzll_fetch_packet_from_rx_fifo(pipe, rx_discard, &data_payload_length);
+                device->resend = true;
+            }
+        }
+    }
+    else
+    {
+        nrf_gzll_flush_rx_fifo(pipe);
+    }
+
+    //load ACK payload into TX queue, the receiver's addresses and the pipe
+    //given for a half pairing
+    if (paired_pipe != PAIRING_PIPE)
+    {
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            paired_payload[PAYLOAD_PAIRED_ID + i] = id >> (8 * i);
+        }
+        paired_payload[PAYLOAD_PAIRED_PIPE] = paired_pipe;
+        nrf_gzll_add_packet_to_tx_fifo(pipe, paired_payload, PAIRED_PAYLOAD_LENGTH);
+        return;
+    }
+    load_control(pipe, now);
+}
@@ -0,0 +1,43 @@
+#include "rx_ring.h"
+
+// Slot contents must be written before head moves, and read before tail
+// moves. A compiler barrier is enough on the single, in order, M0 core.
+#define RING_BARRIER() __asm__ volatile ("" ::: "memory")
+
+rx_slot_t *rx_ring_claim(rx_ring_t *ring)
+{
+    uint32_t head = ring->head;
+
+    if (head - ring->tail >= RX_RING_SLOTS)
+    {
+        ring->overrun++;
+        return 0;
+    }
+
+    return &ring->slot[head % RX_RING_SLOTS];
+}
+
+void rx_ring_push(rx_ring_t *ring)
+{
+    RING_BARRIER();
+    ring->head++;
+}
+
+rx_slot_t *rx_ring_peek(rx_ring_t *ring)
+{
+    uint32_t tail = ring->tail;
+
+    if (ring->head == tail)
+    {
+        return 0;
+    }
+
+    RING_BARRIER();
+    return &ring->slot[tail % RX_RING_SLOTS];
+}
+
+void rx_ring_pop(rx_ring_t *ring)
+{
+    RING_BARRIER();
+    ring->tail++;
+}
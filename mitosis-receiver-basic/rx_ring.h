@@ -0,0 +1,42 @@
+#ifndef RX_RING_H
+#define RX_RING_H
+
+#include <stdint.h>
+
+// Single producer, single consumer ring of received payloads, one per half.
+// The Gazell interrupt fills slots in place and publishes them by moving
+// head, the main loop reads them in order and frees them by moving tail, so
+// neither side ever sees a slot the other is part way through writing.
+
+#define RX_RING_SLOTS       8       ///< power of two
+#define RX_PAYLOAD_LENGTH   32      ///< NRF_GZLL_CONST_MAX_PAYLOAD_LENGTH
+
+typedef struct
+{
+    uint8_t  payload[RX_PAYLOAD_LENGTH];
+    uint32_t length;
+    uint32_t stamp;                 ///< timebase ticks when it was received
+} rx_slot_t;
+
+typedef struct
+{
+    rx_slot_t slot[RX_RING_SLOTS];
+    volatile uint32_t head;         ///< slots published, only moved by the producer
+    volatile uint32_t tail;         ///< slots freed, only moved by the consumer
+    uint32_t overrun;               ///< payloads dropped with every slot full
+} rx_ring_t;
+
+// Producer side. The slot to fill next, or 0 if the ring is full, counting
+// the payload as an overrun.
+rx_slot_t *rx_ring_claim(rx_ring_t *ring);
+
+// Publish the slot last claimed
+void rx_ring_push(rx_ring_t *ring);
+
+// Consumer side. The oldest published slot, or 0 if there are none.
+rx_slot_t *rx_ring_peek(rx_ring_t *ring);
+
+// Free the slot last peeked
+void rx_ring_pop(rx_ring_t *ring);
+
+#endif
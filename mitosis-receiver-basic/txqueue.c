@@ -0,0 +1,53 @@
+#include <string.h>
+#include "txqueue.h"
+
+// As in rx_ring.c, a compiler barrier orders the slot against head and tail
+#define QUEUE_BARRIER() __asm__ volatile ("" ::: "memory")
+
+bool tx_queue_push(tx_queue_t *queue, const uint8_t *data, uint32_t length)
+{
+    uint32_t head = queue->head;
+    uint32_t depth = head - queue->tail;
+
+    if (depth >= TX_QUEUE_SLOTS || length > TX_FRAME_LENGTH)
+    {
+        queue->dropped++;
+        return false;
+    }
+
+    memcpy(queue->frame[head % TX_QUEUE_SLOTS].data, data, length);
+    queue->frame[head % TX_QUEUE_SLOTS].length = length;
+
+    QUEUE_BARRIER();
+    queue->head = head + 1;
+
+    if (depth + 1 > queue->max_depth)
+    {
+        queue->max_depth = depth + 1;
+    }
+    return true;
+}
+
+uint32_t tx_queue_depth(const tx_queue_t *queue)
+{
+    return queue->head - queue->tail;
+}
+
+tx_frame_t *tx_queue_peek(tx_queue_t *queue)
+{
+    uint32_t tail = queue->tail;
+
+    if (queue->head == tail)
+    {
+        return 0;
+    }
+
+    QUEUE_BARRIER();
+    return &queue->frame[tail % TX_QUEUE_SLOTS];
+}
+
+void tx_queue_pop(tx_queue_t *queue)
+{
+    QUEUE_BARRIER();
+    queue->tail++;
+}
@@ -0,0 +1,44 @@
+#ifndef TXQUEUE_H
+#define TXQUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Single producer, single consumer queue of whole frames for the UART. The
+// main loop copies each frame into a slot, so the transmitter always sends a
+// consistent snapshot, and the UART interrupt sends the slots in order,
+// freeing each one when it is done.
+
+#define TX_QUEUE_SLOTS      8       ///< power of two
+#define TX_FRAME_LENGTH     48      ///< longest frame, FRAMED_MAX_ENCODED
+
+typedef struct
+{
+    uint8_t  data[TX_FRAME_LENGTH];
+    uint32_t length;
+} tx_frame_t;
+
+typedef struct
+{
+    tx_frame_t frame[TX_QUEUE_SLOTS];
+    volatile uint32_t head;         ///< frames queued, only moved by the main loop
+    volatile uint32_t tail;         ///< frames sent, only moved by the interrupt
+    uint32_t dropped;               ///< frames thrown away with every slot full
+    uint32_t max_depth;             ///< most frames ever waiting
+    volatile uint32_t underruns;    ///< times the UART went idle with frames still to build
+} tx_queue_t;
+
+// Main loop side. Queue a copy of a frame, returning false and counting it as
+// dropped if the queue is full.
+bool tx_queue_push(tx_queue_t *queue, const uint8_t *data, uint32_t length);
+
+// Frames waiting to be sent, including the one in progress
+uint32_t tx_queue_depth(const tx_queue_t *queue);
+
+// Interrupt side. The frame to send next, or 0 if there are none.
+tx_frame_t *tx_queue_peek(tx_queue_t *queue);
+
+// Free the frame last peeked, once it has been sent
+void tx_queue_pop(tx_queue_t *queue);
+
+#endif